@@ -0,0 +1,324 @@
+// 非同步(asynchronous)、lock-free的logger (-std=c++17以上，Linux/POSIX，使用write(2))
+// 1. 原本每個worker都是 std::lock_guard<std::mutex> lk(mo); std::cout << ... << std::endl;
+//    所有執行緒輪流搶同一個mutex，而且每一行都會flush(一次write system call)，輸出把整個pool串成一條線。
+// 2. LOG() << "[" << std::this_thread::get_id() << "] from: " << from << " -> to: " << to;
+//    a. 先在呼叫端自己的stack上格式化成一行(數字使用std::to_chars，不經過locale以及stream的狀態)，
+//       LOG()這個暫時物件解構時才把整行送出，自動補上換行。
+//    b. 每條執行緒有自己的single-producer/single-consumer ring buffer(第一次使用時註冊，之後完全不拿鎖)，
+//       生產者只寫head，背景的writer執行緒只寫tail，彼此只用acquire/release同步。
+//       執行緒結束時thread_local的RingOwner把ring標記為closed，writer把剩下的紀錄寫完以後釋放它，
+//       大量短命的執行緒不會讓ring越積越多。
+//    c. writer執行緒輪流把所有ring中的紀錄搬到一個大的batch buffer，一整批才呼叫一次write(2)。
+//       沒有紀錄時在condition variable上睡覺(不定時醒來輪詢)：writer先設parked_再檢查一次所有的ring，
+//       生產者放入紀錄以後檢查parked_，兩邊中間都有seq_cst fence，至少有一邊會看到對方，不會漏掉叫醒；
+//       writer醒著的時候生產者不需要拿鎖。
+//    d. ring滿了的時候依照Policy：
+//       Drop  -> 丟掉這一行並計數，writer之後會輸出一行 "[async_log] dropped N lines" (預設，不會擋住worker)
+//       Block -> 叫醒writer並讓出CPU，直到有空位為止(不會遺失任何一行)
+// 3. flush()等到呼叫之前送出的紀錄都寫出去為止；程式結束時(static物件解構)會自動寫完剩下的紀錄。
+//    之後要再使用std::cout輸出時，先flush()，才不會和還沒寫出去的紀錄交錯。
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+
+namespace async_log{
+
+enum class Policy{ Drop, Block };
+
+class Ring{
+public:
+    static constexpr std::size_t capacity = 1024;      // 每條執行緒最多累積幾行還沒寫出去
+    static constexpr std::size_t max_line = 252;
+
+    struct Record{
+        std::uint32_t len;
+        char text[max_line];
+    };
+
+    Ring(): buf_(new Record[capacity]){}
+
+    bool try_push(const char* s, std::size_t n){
+        std::size_t h = head_.load(std::memory_order_relaxed);
+        if(h - tail_.load(std::memory_order_acquire) == capacity) return false;
+        Record& r = buf_[h % capacity];
+        r.len = (std::uint32_t)n;
+        std::memcpy(r.text, s, n);
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只有writer執行緒會呼叫：把目前所有的紀錄交給f，回傳處理了幾行
+    template<typename F>
+    std::size_t drain(F f){
+        std::size_t t = tail_.load(std::memory_order_relaxed);
+        std::size_t h = head_.load(std::memory_order_acquire);
+        for(std::size_t i = t; i < h; i++){
+            const Record& r = buf_[i % capacity];
+            f(r.text, r.len);
+        }
+        tail_.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> dropped{0};             // 只有生產者會寫入
+    std::uint64_t reported = 0;                         // 只有writer使用：已經回報過的dropped
+    std::atomic<bool> closed{false};                    // 生產者的執行緒已經結束，不會再寫入
+
+private:
+    std::unique_ptr<Record[]> buf_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+class Logger{
+public:
+    static Logger& instance(){
+        static Logger l;
+        return l;
+    }
+
+    void set_policy(Policy p){ policy_.store(p, std::memory_order_relaxed); }
+
+    void submit(const char* s, std::size_t n){
+        Ring& ring = local();
+        if(ring.try_push(s, n)){
+            wake_if_parked();
+            return;
+        }
+        if(policy_.load(std::memory_order_relaxed) == Policy::Drop){
+            ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            wake_if_parked();                           // 讓writer回報dropped
+            return;
+        }
+        do{
+            wake_if_parked();                           // ring滿了：叫writer起來清
+            std::this_thread::yield();
+        }while(!ring.try_push(s, n));
+        wake_if_parked();
+    }
+
+    void flush(){
+        std::unique_lock<std::mutex> uk(m);
+        std::uint64_t target = ++flush_requested_;
+        cv.notify_one();
+        flushed_cv.wait(uk, [&]{ return flushed_ >= target; });
+    }
+
+    ~Logger(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stop_ = true;
+        }
+        cv.notify_one();
+        writer_.join();
+    }
+
+private:
+    Logger(): writer_([this]{ run(); }){}
+
+    // 執行緒結束時把ring標記為closed；ring由shared_ptr共同持有，Logger先解構也不會留下懸空的指標。
+    struct RingOwner{
+        std::shared_ptr<Ring> ring;
+        ~RingOwner(){
+            if(ring) ring->closed.store(true, std::memory_order_release);
+        }
+    };
+
+    Ring& local(){
+        thread_local RingOwner owner;
+        if(!owner.ring){
+            owner.ring = std::make_shared<Ring>();
+            std::lock_guard<std::mutex> lk(m);
+            rings_.push_back(owner.ring);
+        }
+        return *owner.ring;
+    }
+
+    // 生產者：寫入紀錄以後，writer正在睡覺的話叫醒它 (fence與run()中的fence配對)
+    void wake_if_parked(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(!parked_.load(std::memory_order_relaxed)) return;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            parked_.store(false, std::memory_order_relaxed);
+        }
+        cv.notify_one();
+    }
+
+    bool any_pending(){
+        std::lock_guard<std::mutex> lk(m);
+        for(const auto& ring: rings_){
+            if(!ring->empty() || ring->closed.load(std::memory_order_relaxed) ||
+               ring->dropped.load(std::memory_order_relaxed) != ring->reported) return true;
+        }
+        return false;
+    }
+
+    void write_all(){
+        std::size_t off = 0;
+        while(off < batch_.size()){
+            ssize_t w = ::write(STDOUT_FILENO, batch_.data() + off, batch_.size() - off);
+            if(w <= 0) break;
+            off += w;
+        }
+        batch_.clear();
+    }
+
+    // 把所有ring清空一次，回傳處理了幾行；生產者已經結束的ring寫完以後移除。
+    std::size_t drain_all(){
+        std::size_t lines = 0;
+        std::size_t count;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            count = rings_.size();
+        }
+        bool retire = false;
+        for(std::size_t i = 0; i < count; i++){
+            Ring* ring;
+            {
+                std::lock_guard<std::mutex> lk(m);   // rings_可能正在被push_back (重新配置)
+                ring = rings_[i].get();
+            }
+            bool closed = ring->closed.load(std::memory_order_acquire);   // 在drain之前讀：closed之前的紀錄都看得到
+            retire = retire || closed;
+            lines += ring->drain([this](const char* s, std::size_t n){
+                batch_.insert(batch_.end(), s, s + n);
+                if(batch_.size() >= batch_size) write_all();
+            });
+            std::uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+            if(dropped != ring->reported){
+                std::string msg = "[async_log] dropped " + std::to_string(dropped - ring->reported) + " lines\n";
+                batch_.insert(batch_.end(), msg.begin(), msg.end());
+                ring->reported = dropped;
+            }
+        }
+        write_all();                                    // 一整批只呼叫一次write(2)
+        if(retire){                                     // 只有writer會移除，上面的索引在迴圈中一直有效
+            std::lock_guard<std::mutex> lk(m);
+            rings_.erase(std::remove_if(rings_.begin(), rings_.begin() + count, [](const std::shared_ptr<Ring>& r){
+                return r->closed.load(std::memory_order_acquire) && r->empty() &&
+                       r->dropped.load(std::memory_order_relaxed) == r->reported;
+            }), rings_.begin() + count);
+        }
+        return lines;
+    }
+
+    void run(){
+        batch_.reserve(batch_size);
+        while(true){
+            std::uint64_t target;
+            bool stop;
+            {
+                std::lock_guard<std::mutex> lk(m);
+                target = flush_requested_;
+                stop = stop_;
+            }
+            std::size_t lines = drain_all();
+            {
+                std::unique_lock<std::mutex> uk(m);
+                if(flushed_ < target){
+                    flushed_ = target;
+                    flushed_cv.notify_all();
+                }
+                if(stop) return;                        // stop之前送出的紀錄在這一輪已經寫完
+                if(lines != 0) continue;
+                parked_.store(true, std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);   // 與wake_if_parked()中的fence配對
+            if(any_pending()){                          // 設parked_之前放入的紀錄
+                parked_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> uk(m);
+            cv.wait(uk, [this]{ return !parked_.load(std::memory_order_relaxed) || stop_ || flush_requested_ != flushed_; });
+            parked_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr std::size_t batch_size = 64 * 1024;
+
+    std::mutex m;                                       // 只保護註冊、flush以及睡覺/叫醒
+    std::condition_variable cv;
+    std::condition_variable flushed_cv;
+    std::vector<std::shared_ptr<Ring>> rings_;
+    std::vector<char> batch_;                           // 只有writer使用
+    std::atomic<Policy> policy_{Policy::Drop};
+    std::atomic<bool> parked_{false};                   // writer正在(或準備)睡覺
+    std::uint64_t flush_requested_ = 0;
+    std::uint64_t flushed_ = 0;
+    bool stop_ = false;
+    std::thread writer_;                                // 最後一個成員：其他成員都初始化好以後才啟動
+};
+
+class Line{
+public:
+    Line() = default;
+    Line(const Line&) = delete;
+    Line& operator=(const Line&) = delete;
+    ~Line(){
+        buf_[n_++] = '\n';
+        Logger::instance().submit(buf_, n_);
+    }
+
+    Line& operator<<(std::string_view s){
+        std::size_t k = std::min(s.size(), room());
+        std::memcpy(buf_ + n_, s.data(), k);
+        n_ += k;
+        return *this;
+    }
+    Line& operator<<(const char* s){ return *this << std::string_view{s}; }
+    Line& operator<<(const std::string& s){ return *this << std::string_view{s}; }
+    Line& operator<<(char c){
+        if(room() > 0) buf_[n_++] = c;
+        return *this;
+    }
+    template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>>>
+    Line& operator<<(T v){
+        auto [p, ec] = std::to_chars(buf_ + n_, buf_ + n_ + room(), v);
+        if(ec == std::errc{}) n_ = p - buf_;
+        return *this;
+    }
+    Line& operator<<(bool b){ return *this << (b ? "true" : "false"); }
+    Line& operator<<(std::thread::id id){                // 與std::cout輸出的格式相同，自己的id只格式化一次
+        if(id == std::this_thread::get_id()){
+            thread_local std::string self = to_string(id);
+            return *this << self;
+        }
+        return *this << to_string(id);
+    }
+
+private:
+    static std::string to_string(std::thread::id id){
+        std::ostringstream ss;
+        ss << id;
+        return ss.str();
+    }
+
+    std::size_t room() const { return Ring::max_line - 1 - n_; }   // 保留一格給'\n'
+
+    char buf_[Ring::max_line];
+    std::size_t n_ = 0;
+};
+
+}  // namespace async_log
+
+#define LOG() async_log::Line{}
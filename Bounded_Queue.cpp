@@ -0,0 +1,196 @@
+// 編譯參數： -std=c++20 -O2 (RSS由/proc/self/status讀取，Linux only)
+// 1. 原本的Queue<T>內部是沒有上限的std::deque，生產者(例如quick_sort的partition或是讀檔的執行緒)
+//    比消費者快的時候，佇列會一直長大，直到把記憶體用光。
+// 2. Queue<T>(capacity)：capacity = 0時與原本相同(沒有上限)；capacity > 0時為有上限(bounded)的佇列：
+//    a. 建構時就配置好capacity格的ring buffer，之後的Enqueue/WaitandDequeue都不會再配置記憶體。
+//    b. 背壓(backpressure)：佇列滿了的時候
+//       Enqueue         -> 在not_full上等到有空位為止 (佇列被Close時回傳false)
+//       TryEnqueue      -> 立刻回傳false
+//       EnqueueFor      -> 最多等timeout，逾時回傳false
+//       三個都以T&&接收，失敗時val不會被移動(move)，呼叫端可以決定要重試或是丟掉；
+//       Enqueue另外接受const T&(複製一份再放入)。
+//    c. 兩個condition variable：not_empty給消費者等，not_full給生產者等，彼此不會叫錯人。
+// 3. main為benchmark：一個生產者以比消費者快的速度產生任務，比較bounded以及unbounded的throughput以及RSS。
+//    VmHWM(peak RSS)只會增加不會減少，因此先跑bounded再跑unbounded。
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <optional>
+#include <array>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+using namespace std::literals;
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;                  // capacity_ == 0
+    std::vector<std::optional<T>> ring_;  // capacity_ > 0，建構時配置好
+    std::size_t capacity_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    bool full_locked() const { return capacity_ != 0 && size_ == capacity_; }
+
+    void push_locked(T&& val){
+        if(capacity_ == 0) dq_.push_back(std::move(val));
+        else ring_[(head_ + size_) % capacity_].emplace(std::move(val));
+        size_++;
+    }
+
+    void pop_locked(T& value){
+        if(capacity_ == 0){
+            value = std::move(dq_.front());
+            dq_.pop_front();
+        }else{
+            value = std::move(*ring_[head_]);
+            ring_[head_].reset();
+            head_ = (head_ + 1) % capacity_;
+        }
+        size_--;
+    }
+
+public:
+    explicit Queue(std::size_t capacity = 0): ring_(capacity), capacity_(capacity){}
+
+    std::size_t capacity() const { return capacity_; }
+
+    bool Enqueue(T&& val){
+        {
+            std::unique_lock<std::mutex> uk(m);
+            not_full.wait(uk, [this]{return (!full_locked()||closed.load());});
+            if(closed.load()) return false;
+            push_locked(std::move(val));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+    bool Enqueue(const T& val){
+        T copy = val;
+        return Enqueue(std::move(copy));
+    }
+    bool TryEnqueue(T&& val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if(full_locked() || closed.load()) return false;
+            push_locked(std::move(val));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+    template<typename Rep, typename Period>
+    bool EnqueueFor(T&& val, std::chrono::duration<Rep, Period> timeout){
+        {
+            std::unique_lock<std::mutex> uk(m);
+            if(!not_full.wait_for(uk, timeout, [this]{return (!full_locked()||closed.load());})) return false;
+            if(closed.load()) return false;
+            push_locked(std::move(val));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+    bool WaitandDequeue(T& value){
+        {
+            std::unique_lock<std::mutex> uk(m);
+            not_empty.wait(uk, [this]{return (size_ != 0||closed.load());});
+            if(size_ == 0) return false;
+            pop_locked(value);
+        }
+        if(capacity_ != 0) not_full.notify_one();
+        return true;
+    }
+    void Close(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            closed.store(true);
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+struct Item{
+    std::array<unsigned int, 32> payload;   // 128 bytes
+};
+
+// 從/proc/self/status讀取某一欄(kB)
+long read_status_kb(const std::string& key){
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while(std::getline(in, line)){
+        if(line.rfind(key + ":", 0) == 0) return std::stol(line.substr(key.size() + 1));
+    }
+    return -1;
+}
+
+enum class Mode{ Block, Drop };
+
+void bench(const char* name, std::size_t capacity, Mode mode, int items, int consumers_num){
+    long rss_before = read_status_kb("VmRSS");
+    std::size_t dropped = 0;
+    std::atomic<unsigned long long> checksum{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        Queue<Item> q(capacity);
+        std::vector<std::thread> consumers;
+        for(int i = 0; i < consumers_num; i++){
+            consumers.push_back(std::thread{[&q, &checksum]{
+                Item item;
+                unsigned long long local = 0;
+                while(q.WaitandDequeue(item)){
+                    for(int r = 0; r < 16; r++){            // 讓消費者比生產者慢
+                        for(auto v: item.payload) local += v * (r + 1);
+                    }
+                }
+                checksum += local;
+            }});
+        }
+        for(int i = 0; i < items; i++){
+            Item item;
+            item.payload.fill(i);
+            if(mode == Mode::Block) q.Enqueue(std::move(item));
+            else if(!q.TryEnqueue(std::move(item))) dropped++;
+        }
+        q.Close();
+        for(auto& t: consumers){
+            t.join();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double sec = std::chrono::duration<double>(end - start).count();
+    std::cout << name << "\t" << (items - dropped) / sec / 1e6 << " M items/s"
+              << "\tpeak RSS: " << read_status_kb("VmHWM") / 1024 << " MB (+" << std::max(0L, read_status_kb("VmHWM") - rss_before) / 1024 << " MB)"
+              << "\tdropped: " << dropped << "\tchecksum: " << checksum << std::endl;
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    int consumers_num = std::max(1, thread_num / 2);
+    int items = argc > 1 ? std::stoi(argv[1]) : 2000000;
+    std::cout << "Avaliable Threads: " << thread_num << ", consumers: " << consumers_num
+              << ", items: " << items << " x " << sizeof(Item) << " bytes" << std::endl;
+
+    // EnqueueFor的簡單示範：佇列滿了而且沒有人消費時會逾時
+    {
+        Queue<int> q(2);
+        int a = 1, b = 2, c = 3;
+        std::cout << "EnqueueFor on a full queue: " << q.EnqueueFor(std::move(a), 1ms) << q.EnqueueFor(std::move(b), 1ms)
+                  << q.EnqueueFor(std::move(c), 10ms) << std::endl;
+    }
+
+    bench("bounded (1024, block)", 1024, Mode::Block, items, consumers_num);
+    bench("bounded (1024, drop)", 1024, Mode::Drop, items, consumers_num);
+    bench("unbounded", 0, Mode::Block, items, consumers_num);
+
+    return 0;
+}
@@ -7,6 +7,8 @@
 #include <atomic>
 #include <condition_variable>
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
 using namespace std::literals;
 template<typename T>
 class Queue {
@@ -24,6 +26,20 @@ public:
         is_close.store(true);
         cv.notify_all();
     }
+    template<typename Range>
+    void EnqueueBulk(Range&& values) {   // Elements of a temporary range are moved in.
+        std::size_t n = 0;
+        {
+            std::lock_guard lk(mq);
+            for(auto& value: values) {
+                if constexpr(std::is_lvalue_reference_v<Range>) dq_.push_back(value);
+                else dq_.push_back(std::move(value));
+                n++;
+            }
+        }
+        if(n == 1) cv.notify_one();
+        else if(n > 1) cv.notify_all();
+    }
     bool WaitAndDeque(T& value) {
         std::unique_lock<std::mutex> uk(mq);
         cv.wait(uk, [&](){return !dq_.empty() || is_close;});
@@ -32,6 +48,17 @@ public:
         dq_.pop_front();
         return true;
     }
+    template<typename OutputIt>
+    std::size_t WaitAndDequeueUpTo(std::size_t n, OutputIt out) {
+        std::unique_lock<std::mutex> uk(mq);
+        cv.wait(uk, [&](){return !dq_.empty() || is_close;});
+        std::size_t k = std::min(n, dq_.size());
+        for(std::size_t i = 0; i < k; i++) {
+            *out++ = std::move(dq_.front());
+            dq_.pop_front();
+        }
+        return k;
+    }
 };
 
 struct Job{
@@ -70,17 +97,20 @@ int main() {
 
     std::this_thread::sleep_for(500ms);
     int range = std::ceil((double) n / (double) thread_no);
+    std::vector<Job> batch;
     for(int i = 1; i <= thread_no; i++){
-        Jobs.Enque({1 + (i-1)*range, std::min((i)*range, n)});
+        batch.push_back({1 + (i-1)*range, std::min((i)*range, n)});
     }
+    Jobs.EnqueueBulk(batch);
     Jobs.Close();
 
     for(auto& t: Workers) t.join();
     
     Results.Close();
-    int res{0}, final_result{0};
-    while(Results.WaitAndDeque(res)){
-        final_result += res;
+    int res[16], final_result{0};
+    std::size_t k;
+    while((k = Results.WaitAndDequeueUpTo(16, res)) > 0){
+        for(std::size_t i = 0; i < k; i++) final_result += res[i];
     }
     std::cout << "The sum is " << final_result << std::endl;
 
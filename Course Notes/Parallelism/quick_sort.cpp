@@ -1,214 +1,552 @@
-#include <iostream>
-#include <vector>
-#include <deque>
-#include <mutex>
-#include <thread>
-#include <condition_variable>
-#include <cmath>
-#include <atomic>
-#include <algorithm>
-#include <chrono>
-#include <execution>
-
-using namespace std::literals;
-
-void quickSort(std::vector<int>& nums, int first, int last) {
-	if(first == last) return;
-	// The picked element is randomly choosed (better), in this case, it's the first element of the vector in this current run.
-	// i is responsible for recording element position whose value is greater than the picked element.
-	// j is responsible for recording element position whose value is less than the picked element.
-	// Classification (greater or less than)
-	int j = first+1;
-	for(int i = first+1; i < last; i++){
-		if(nums[i] < nums[first]) {
-			std::swap(nums[i], nums[j]);
-			j++;
-		}
-	}
-	// Put the picked element into the right position of the vector.
-	int mid = j-1;
-	std::swap(nums[first], nums[mid]);
-	// In each run, only the originally first element (the current mid position element) will be in the correct position.
-	quickSort(nums, first, mid);
-	quickSort(nums, mid+1, last);
-}
-
-void quickSort(std::vector<int>& nums) {
-	quickSort(nums, 0, nums.size());
-}
-
-template<typename T>
-class Queue {
-    std::deque<T> d_;
-    std::mutex m_;
-    std::atomic<bool> is_closed_{false};
-    std::condition_variable cond_;
-public:
-    void Enqueue(T value) { 
-        std::lock_guard lk(m_);
-        d_.push_back(value);
-        cond_.notify_one();
-    }
-    void Close() {
-        is_closed_.store(true);
-        cond_.notify_all();
-    }
-    bool WaitAndDequeue(T& value) {
-        std::unique_lock lk(m_);
-        cond_.wait(lk, [&]() { return !d_.empty() || is_closed_.load(); });
-        if (d_.empty()) return false;
-        value = d_.front();
-        d_.pop_front();
-        return true;
-    }
-};
-
-// from + (from + 1) + ... + to
-struct Job {
-    int from;
-    int to;
-};
-
-
-void quickSortMThread(std::vector<int>& nums, int first, int last, Queue<Job>& jobs, std::atomic<int>& remains) {
-	// Concept:
-	// * First manually divide the task (quick sort on the input vector) multiple times (level). After 
-	//   several level's dividing, send the subtask (quick sort on each section) into to the worker 
-	//   queue list to achieve the multithreading.
-	// * vector is divided into several sections for multiple threads, one section for each thread.
-	// * Quicksort each section in each thread.
-	// * Merge each sorted section of each thread into a completely sorted one.
-	// * Since the quick sort is a recursion operation, there will be multiple quick sort operations.
-	// * Use the worker queue list to let the worker (thread) take the job (quick sort).
-    while(true) {
-        if(first == last) return;
-        int j = first+1;
-        for(int i = first+1; i < last; i++){
-            if(nums[i] < nums[first]) {
-                std::swap(nums[i], nums[j]);
-                j++;
-            }
-        }
-        int mid = j-1;
-        std::swap(nums[first], nums[mid]);
-        
-        if(last - first < 100) {                        
-            quickSortMThread(nums, first, mid, jobs, remains);               
-                                      // Optimization 1: 
-                                      // If the task is affordable (small) enough, there is no need 
-                                      // to launch a new thread. This will prevent the extra overhead.
-                                      // -> More efficiently.
-        } else {
-            remains += 1;                 // Add a task and increase the indicator.
-            jobs.Enqueue({first, mid});   // Assign the task with enqueue
-            // quickSortMThread(nums, first, mid);
-        }
-
-        first = mid + 1;              // Optimization 2 (this line and the above while-true loop): 
-                                      // Continue perform the quick sort on the right section on the 
-                                      // current thread. (Since current thread has finished its work, 
-                                      // and no further work is requested.)
-    }
-}
-
-void quickSortMThread(std::vector<int>& nums, Queue<Job>& jobs, std::atomic<int>& remains) {
-	quickSortMThread(nums, 0, nums.size(), jobs, remains);
-}
-
-
-int main() {
-	std::cout << "Hello there!!" << std::endl;
-	
-	std::vector<int> v1 = {1, 3, 2, 5, 4};
-	std::vector<int> v2 = {3, 1, 2, 4, 5};
-    int size = 3000; 
-	std::vector<int> v3(size);
-
-	for(int i = size; i > 0; i--){
-		v3[size-i] = i;
-	}
-
-    size = 1000000;
-    std::vector<int> v4(size);
-	for(int i = size; i > 0; i--){
-        v4[size-i] = i;
-	}    
-	
-    /* Single-threaded Quick Sort */
-	quickSort(v1);
-	quickSort(v2);
-
-    /* Multiple-threaded Quick Sort */
-	int thread_num = std::thread::hardware_concurrency();
-    // std::cout << thread_num << std::endl;
-	std::vector<std::thread> workers(thread_num);
-	Queue<Job> jobs;
-	std::atomic<int> remains{1};              // Add a task and increase the indicator.
-	jobs.Enqueue({0, (int)v3.size()});
-	// quickSortMThread(v3, jobs);
-	for(int i = 0; i < thread_num; i++){
-		workers[i] = std::thread([&v3, &jobs, &remains](){
-			Job job;
-			while(jobs.WaitAndDequeue(job)){  // Do the task with dequeue.
-				quickSortMThread(v3, job.from, job.to, jobs, remains);
-				remains -= 1;                 // Finish the job. Decrease the indicator.
-			}
-		});
-	}
-	while(remains != 0){ // -> busy waiting ... -> not efficiently
-                         // Waiting for the remains decrease to 0. 
-                         // i.e. All the works are finished.
-        std::this_thread::yield();            // Optimization 3 (improve for the busy-waiting):
-                                              // Force to wait other threads to work 
-                                              // (release the resource).
-    }
-	jobs.Close();
-
-	for(auto& w: workers){
-		w.join();
-	}
-
-    /* std::sort with C++20 parallelized sorting (compiler or library supported required) */
-    auto start = std::chrono::steady_clock::now();
-    std::sort(v4.begin(), v4.end());
-    auto end = std::chrono::steady_clock::now();
-    std::cout << "Default: \t" << (end - start).count() << "ns" << std::endl;
-
-    start = std::chrono::steady_clock::now();
-    std::sort(std::execution::seq, v4.begin(), v4.end());
-    end = std::chrono::steady_clock::now();
-    std::cout << "seq: \t\t" << (end - start).count() << "ns" << std::endl;
-
-    start = std::chrono::steady_clock::now();
-    std::sort(std::execution::par, v4.begin(), v4.end());
-    end = std::chrono::steady_clock::now();
-    std::cout << "par: \t\t" << (end - start).count() << "ns" << std::endl;
-
-    start = std::chrono::steady_clock::now();
-    std::sort(std::execution::par_unseq, v4.begin(), v4.end());
-    end = std::chrono::steady_clock::now();
-    std::cout << "par_unseq: \t" << (end - start).count() << "ns" << std::endl;
-
-    start = std::chrono::steady_clock::now();
-    std::sort(std::execution::unseq, v4.begin(), v4.end());
-    end = std::chrono::steady_clock::now();
-    std::cout << "unseq: \t\t" << (end - start).count() << "ns" << std::endl;
-
-    /* Print the results. */
-	for(int x: v1) {
-		std::cout << x << " ";
-	}
-	std::cout << std::endl;
-
-	for(int x: v2) {
-		std::cout << x << " ";
-	}
-	std::cout << std::endl;
-
-	for(int x: v3) {
-		std::cout << x << " ";
-	}
-	std::cout << std::endl;
-
-	return 0;
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <functional>
+#include <random>
+#include <climits>
+#include <memory>
+#include <variant>
+
+#include "../../Sorting_Network.hpp"
+#include "../../Partition_Kernel.hpp"
+
+using namespace std::literals;
+
+// Always picking the first element as the pivot makes sorted and reversed inputs O(n^2) with
+// recursion depth n. Both quickSort and quickSortMThread follow pdqsort instead:
+// * Median-of-3 pivot (ninther, the median of three medians-of-3, for long ranges).
+// * Ranges that are already sorted or strictly reversed are detected up front.
+// * Every range carries a budget of unbalanced partitions (log2(n) at the start). Each unbalanced
+//   partition breaks the input pattern by swapping a few elements; when the budget runs out the
+//   range is heapsorted, so the worst case is O(n log n).
+// * If the element before the range (a previous pivot) equals the new pivot, the range has no
+//   smaller elements: put everything equal to the pivot on the left and skip it (many duplicates).
+constexpr int nintherMin = 128;
+
+int log2Floor(int n) {
+    int l = 0;
+    while(n >>= 1) l++;
+    return l;
+}
+
+// Leaf ranges are sorted with the compile-time sorting networks in the root Sorting_Network.hpp
+// (network::small_sort): branch-free compare-exchanges up to network::max_size elements, then
+// insertion sort up to network::small_sort_max.
+void smallSort(std::vector<int>& nums, int first, int last) {
+    network::small_sort(nums.data() + first, last - first);
+}
+
+// Sort the elements at a, b and c, the median ends up at b.
+void sort3(std::vector<int>& nums, int a, int b, int c) {
+    if(nums[b] < nums[a]) std::swap(nums[a], nums[b]);
+    if(nums[c] < nums[b]) std::swap(nums[b], nums[c]);
+    if(nums[b] < nums[a]) std::swap(nums[a], nums[b]);
+}
+
+// Move the median-of-3 (or ninther) to nums[first].
+void choosePivot(std::vector<int>& nums, int first, int last) {
+    int half = first + (last - first) / 2;
+    if(last - first >= nintherMin) {
+        sort3(nums, first, half, last-1);
+        sort3(nums, first+1, half-1, last-2);
+        sort3(nums, first+2, half+1, last-3);
+        sort3(nums, half-1, half, half+1);
+    } else {
+        sort3(nums, first, half, last-1);
+    }
+    std::swap(nums[first], nums[half]);
+}
+
+void breakPattern(std::vector<int>& nums, int first, int last) {
+    int len = last - first;
+    if(len < network::small_sort_max) return;
+    std::swap(nums[first], nums[first + len/4]);
+    std::swap(nums[last-1], nums[last - len/4]);
+    if(len >= nintherMin) {
+        std::swap(nums[first+1], nums[first + len/4 + 1]);
+        std::swap(nums[first+2], nums[first + len/4 + 2]);
+        std::swap(nums[last-2], nums[last - len/4 - 1]);
+        std::swap(nums[last-3], nums[last - len/4 - 2]);
+    }
+}
+
+// True if [first, last) is sorted, or was strictly reversed and has been reversed in place.
+bool sortedRun(std::vector<int>& nums, int first, int last) {
+    auto b = nums.begin() + first, e = nums.begin() + last;
+    if(!(nums[first+1] < nums[first])) return std::is_sorted(b, e);
+    if(!std::is_sorted(b, e, std::greater<int>())) return false;
+    std::reverse(b, e);
+    return true;
+}
+
+// Handles the small, sorted and exhausted-budget cases. Returns true if [first, last) is done.
+bool sortLeafCases(std::vector<int>& nums, int first, int last, int badAllowed) {
+    if(last - first <= network::small_sort_max) {
+        smallSort(nums, first, last);
+        return true;
+    }
+    if(sortedRun(nums, first, last)) return true;
+    if(badAllowed <= 0) {
+        std::make_heap(nums.begin() + first, nums.begin() + last);
+        std::sort_heap(nums.begin() + first, nums.begin() + last);
+        return true;
+    }
+    return false;
+}
+
+void quickSort(std::vector<int>& nums, int first, int last, int badAllowed) {
+    while(!sortLeafCases(nums, first, last, badAllowed)) {
+        // The picked element is the median of the first, middle and last elements, moved to the front.
+        choosePivot(nums, first, last);
+        int pivot = nums[first];
+        // i is responsible for recording element position whose value is greater than the picked element.
+        // j is responsible for recording element position whose value is less than the picked element.
+        if(first > 0 && !(nums[first-1] < pivot)) {
+            // Nothing in the range is less than the pivot: gather the equal elements on the left, they are done.
+            int j = first+1;
+            for(int i = first+1; i < last; i++){
+                if(!(pivot < nums[i])) {
+                    std::swap(nums[i], nums[j]);
+                    j++;
+                }
+            }
+            std::swap(nums[first], nums[j-1]);
+            first = j;
+            continue;
+        }
+        // Classification (greater or less than)
+        int j = first+1;
+        for(int i = first+1; i < last; i++){
+            if(nums[i] < pivot) {
+                std::swap(nums[i], nums[j]);
+                j++;
+            }
+        }
+        // Put the picked element into the right position of the vector.
+        int mid = j-1;
+        std::swap(nums[first], nums[mid]);
+        if(std::min(mid - first, last - mid - 1) < (last - first) / 8) {
+            badAllowed--;
+            breakPattern(nums, first, mid);
+            breakPattern(nums, mid+1, last);
+        }
+        // In each run, only the picked element (the current mid position element) will be in the correct position.
+        quickSort(nums, first, mid, badAllowed);
+        first = mid+1;
+    }
+}
+
+void quickSort(std::vector<int>& nums) {
+	quickSort(nums, 0, nums.size(), log2Floor(nums.size()) + 1);
+}
+
+template<typename T>
+class Queue {
+    std::deque<T> d_;
+    std::mutex m_;
+    std::atomic<bool> is_closed_{false};
+    std::condition_variable cond_;
+public:
+    void Enqueue(T value) { 
+        std::lock_guard lk(m_);
+        d_.push_back(value);
+        cond_.notify_one();
+    }
+    void Close() {
+        is_closed_.store(true);
+        cond_.notify_all();
+    }
+    bool WaitAndDequeue(T& value) {
+        return WaitAndDequeue(value, [] { return false; });
+    }
+    // Same, but also stop waiting (and return false) once done() is true.
+    template<typename Done>
+    bool WaitAndDequeue(T& value, Done done) {
+        std::unique_lock lk(m_);
+        if(d_.empty() && !is_closed_.load() && !done()) {
+            if(onIdle_ && onIdle_()) cond_.notify_all();
+            idle_++;
+            cond_.wait(lk, [&]() { return !d_.empty() || is_closed_.load() || done(); });
+            idle_--;
+        }
+        if (d_.empty() || done()) return false;
+        value = d_.front();
+        d_.pop_front();
+        return true;
+    }
+    int Idle() const { return idle_.load(std::memory_order_relaxed); }   // Threads waiting for a value.
+    // check() runs (under the lock) whenever a thread finds the queue empty and is about to sleep.
+    // If it returns true, every waiting thread is woken up, e.g. to tell the waiter that all work is done.
+    void OnIdle(std::function<bool()> check) { onIdle_ = std::move(check); }
+private:
+    std::atomic<int> idle_{0};
+    std::function<bool()> onIdle_;
+};
+
+// from + (from + 1) + ... + to
+struct Job {
+    int from;
+    int to;
+    int badAllowed;       // Unbalanced partitions left before falling back to heapsort.
+};
+
+struct Span {             // [from, to)
+    int from;
+    int to;
+};
+
+// Completion counters of one thread. Only the owner writes them, so spawning or finishing a job never
+// touches a cache line shared by all threads (the old global std::atomic<int> remains did).
+struct alignas(64) Counters {
+    std::atomic<long long> spawned{0};    // Jobs this thread put into the queue.
+    std::atomic<long long> finished{0};   // Jobs this thread completed.
+};
+
+void bump(std::atomic<long long>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// All jobs are done once the finished counts add up to the spawned counts. Sum finished first: the
+// spawn of every job counted there happened before its finish, so it is counted in the second sum.
+bool allDone(const std::vector<Counters>& counters) {
+    long long finished = 0, spawned = 0;
+    for(auto& c: counters) finished += c.finished.load(std::memory_order_acquire);
+    for(auto& c: counters) spawned += c.spawned.load(std::memory_order_acquire);
+    return finished == spawned;
+}
+
+// One step of parallelPartition: f(0), ..., f(parts-1) are shared by the caller and the idle workers
+// that pick up a copy of the job from the queue.
+struct BlockJob {
+    std::function<void(int)> f;
+    int parts;
+    std::atomic<int> next{0};   // The next block nobody has taken yet.
+    std::atomic<int> done{0};   // Number of finished blocks.
+    void work() {
+        for(int k; (k = next.fetch_add(1, std::memory_order_relaxed)) < parts; ) {
+            f(k);
+            if(done.fetch_add(1, std::memory_order_acq_rel) + 1 == parts) {
+                done.notify_all();   // The last block is done: wake up the caller in runOnPool.
+            }
+        }
+    }
+};
+
+// A queue entry: sort a range, or help with a BlockJob. The caller may finish the whole job before a
+// worker gets to its copy, so the copies share ownership.
+using Task = std::variant<Job, std::shared_ptr<BlockJob>>;
+
+
+constexpr int partitionBlockMin = 1 << 17;    // Minimum number of elements per thread in parallelPartition.
+constexpr int parallelPartitionMin = 1 << 20; // Ranges at least this long are classified by several threads.
+
+// Run f(0), ..., f(parts-1) on the workers behind `jobs`: post parts-1 copies of the job, take blocks
+// on this thread as well, and return when every block is done. If no worker is free, the caller
+// simply does all of them.
+template<typename F>
+void runOnPool(Queue<Task>& jobs, int parts, F f) {
+    auto job = std::make_shared<BlockJob>();
+    job->f = std::move(f);
+    job->parts = parts;
+    for(int k = 1; k < parts; k++) jobs.Enqueue(job);
+    job->work();
+    // Sleep until the blocks other workers took are done, instead of spinning on yield().
+    for(int d; (d = job->done.load(std::memory_order_acquire)) < parts; ) {
+        job->done.wait(d, std::memory_order_acquire);
+    }
+}
+
+// Classify [first, last) into (goesLeft) and (!goesLeft) in `parts` blocks, return the boundary.
+// * Each thread classifies its own contiguous block locally.
+// * The prefix sum of the per-block counts gives the boundary (mid).
+// * The (!goesLeft) pieces left of mid and the (goesLeft) pieces right of mid have the same total
+//   length, so they are split evenly across the threads and swapped with each other.
+template<typename Pred>
+int parallelPartition(std::vector<int>& nums, int first, int last, Pred goesLeft, int parts, Queue<Task>& jobs) {
+    auto bound = [=](int k) { return first + (int)((long long)(last - first) * k / parts); };
+
+    std::vector<int> less(parts);
+    runOnPool(jobs, parts, [&](int k) {
+        int j = bound(k);
+        for(int i = bound(k); i < bound(k+1); i++) {
+            if(goesLeft(nums[i])) {
+                std::swap(nums[i], nums[j]);
+                j++;
+            }
+        }
+        less[k] = j - bound(k);
+    });
+
+    int mid = first;
+    for(int c : less) mid += c;
+    std::vector<Span> wrongLeft, wrongRight;             // (!goesLeft) left of mid, (goesLeft) right of mid.
+    std::vector<long long> leftPre{0}, rightPre{0};     // Prefix sums of the piece lengths.
+    for(int k = 0; k < parts; k++) {
+        int b = bound(k), s = b + less[k], e = bound(k+1);
+        if(s < std::min(e, mid)) {
+            wrongLeft.push_back({s, std::min(e, mid)});
+            leftPre.push_back(leftPre.back() + wrongLeft.back().to - s);
+        }
+        if(std::max(b, mid) < s) {
+            wrongRight.push_back({std::max(b, mid), s});
+            rightPre.push_back(rightPre.back() + s - wrongRight.back().from);
+        }
+    }
+    long long total = leftPre.back();
+    if(total == 0) return mid;
+
+    runOnPool(jobs, parts, [&](int k) {
+        // Block k swaps the misplaced elements [total*k/parts, total*(k+1)/parts).
+        long long from = total * k / parts, n = total * (k+1) / parts - from;
+        auto seek = [from](const std::vector<Span>& pieces, const std::vector<long long>& pre, std::size_t& idx) {
+            idx = std::upper_bound(pre.begin(), pre.end(), from) - pre.begin() - 1;
+            return pieces[idx].from + (int)(from - pre[idx]);
+        };
+        std::size_t a, b;
+        int pa = seek(wrongLeft, leftPre, a), pb = seek(wrongRight, rightPre, b);
+        while(n > 0) {
+            if(pa == wrongLeft[a].to) pa = wrongLeft[++a].from;
+            if(pb == wrongRight[b].to) pb = wrongRight[++b].from;
+            int len = (int)std::min<long long>(n, std::min(wrongLeft[a].to - pa, wrongRight[b].to - pb));
+            std::swap_ranges(nums.begin() + pa, nums.begin() + pa + len, nums.begin() + pb);
+            pa += len;
+            pb += len;
+            n -= len;
+        }
+    });
+    return mid;
+}
+
+// Number of blocks to classify [first, last) in: 1 unless the range is long and some workers are idle.
+int partitionParts(int first, int last, const Queue<Task>& jobs) {
+    if(last - first < parallelPartitionMin) return 1;
+    return std::max(1, std::min(jobs.Idle() + 1, (last - first) / partitionBlockMin));
+}
+
+// Move the (goesLeft) elements of [first, last) to the front, in parallel for long ranges.
+template<typename Pred>
+int classify(std::vector<int>& nums, int first, int last, Pred goesLeft, Queue<Task>& jobs) {
+    int parts = partitionParts(first, last, jobs);
+    if(parts > 1) {
+        // Optimization 4: The first calls cover (almost) the whole vector, and classifying it
+        // on one thread keeps all the other workers idle. Let the idle workers classify blocks of
+        // large ranges. They are workers of the same pool, so no extra threads are started.
+        return parallelPartition(nums, first, last, goesLeft, parts, jobs);
+    }
+    int j = first;
+    for(int i = first; i < last; i++){
+        if(goesLeft(nums[i])) {
+            std::swap(nums[i], nums[j]);
+            j++;
+        }
+    }
+    return j;
+}
+
+// Same as classify(nums, first, last, x < bound), the short ranges go through partition::kernel
+// (Partition_Kernel.hpp: AVX-512, AVX2 or scalar, picked at run time).
+int classifyLess(std::vector<int>& nums, int first, int last, int bound, Queue<Task>& jobs) {
+    int parts = partitionParts(first, last, jobs);
+    if(parts > 1) {
+        return parallelPartition(nums, first, last, [bound](int x) { return x < bound; }, parts, jobs);
+    }
+    return first + partition::kernel(nums.data() + first, nums.data() + last, bound);
+}
+
+void quickSortMThread(std::vector<int>& nums, int first, int last, int badAllowed, Queue<Task>& jobs, Counters& mine) {
+	// Concept:
+	// * First manually divide the task (quick sort on the input vector) multiple times (level). After 
+	//   several level's dividing, send the subtask (quick sort on each section) into to the worker 
+	//   queue list to achieve the multithreading.
+	// * vector is divided into several sections for multiple threads, one section for each thread.
+	// * Quicksort each section in each thread.
+	// * Merge each sorted section of each thread into a completely sorted one.
+	// * Since the quick sort is a recursion operation, there will be multiple quick sort operations.
+	// * Use the worker queue list to let the worker (thread) take the job (quick sort).
+    while(true) {
+        if(sortLeafCases(nums, first, last, badAllowed)) return;
+        choosePivot(nums, first, last);
+        int pivot = nums[first];
+        if(first > 0 && !(nums[first-1] < pivot)) {
+            // Nothing in the range is less than the pivot: gather the equal elements on the left, they are done.
+            int j = pivot < INT_MAX ? classifyLess(nums, first+1, last, pivot+1, jobs)   // x <= pivot
+                                    : classify(nums, first+1, last, [pivot](int x) { return !(pivot < x); }, jobs);
+            std::swap(nums[first], nums[j-1]);
+            first = j;
+            continue;
+        }
+        int j = classifyLess(nums, first+1, last, pivot, jobs);
+        int mid = j-1;
+        std::swap(nums[first], nums[mid]);
+        if(std::min(mid - first, last - mid - 1) < (last - first) / 8) {
+            badAllowed--;
+            breakPattern(nums, first, mid);
+            breakPattern(nums, mid+1, last);
+        }
+        
+        if(last - first < 100) {                        
+            quickSortMThread(nums, first, mid, badAllowed, jobs, mine);
+                                      // Optimization 1: 
+                                      // If the task is affordable (small) enough, there is no need 
+                                      // to launch a new thread. This will prevent the extra overhead.
+                                      // -> More efficiently.
+        } else {
+            bump(mine.spawned);           // Add a task and increase this thread's indicator.
+            jobs.Enqueue(Job{first, mid, badAllowed});   // Assign the task with enqueue
+            // quickSortMThread(nums, first, mid);
+        }
+
+        first = mid + 1;              // Optimization 2 (this line and the above while-true loop): 
+                                      // Continue perform the quick sort on the right section on the 
+                                      // current thread. (Since current thread has finished its work, 
+                                      // and no further work is requested.)
+    }
+}
+
+void quickSortMThread(std::vector<int>& nums, Queue<Task>& jobs, Counters& mine) {
+	quickSortMThread(nums, 0, nums.size(), log2Floor(nums.size()) + 1, jobs, mine);
+}
+
+
+int main() {
+	std::cout << "Hello there!!" << std::endl;
+	
+	std::vector<int> v1 = {1, 3, 2, 5, 4};
+	std::vector<int> v2 = {3, 1, 2, 4, 5};
+    int size = 3000; 
+	std::vector<int> v3(size);
+
+	for(int i = size; i > 0; i--){
+		v3[size-i] = i;
+	}
+
+    size = 1000000;
+    std::vector<int> v4(size);
+	for(int i = size; i > 0; i--){
+        v4[size-i] = i;
+	}    
+	
+    /* Single-threaded Quick Sort */
+	quickSort(v1);
+	quickSort(v2);
+
+    /* Multiple-threaded Quick Sort */
+	int thread_num = std::thread::hardware_concurrency();
+    // std::cout << thread_num << std::endl;
+	std::vector<std::thread> workers(thread_num);
+	Queue<Task> jobs;
+	std::vector<Counters> counters(thread_num + 1);   // One per worker, the last one is main's.
+	// A worker that runs out of jobs checks whether everything is done and, if so, wakes up main.
+	jobs.OnIdle([&counters] { return allDone(counters); });
+	bump(counters[thread_num].spawned);       // Add a task and increase the indicator.
+	jobs.Enqueue(Job{0, (int)v3.size(), log2Floor(v3.size()) + 1});
+	// quickSortMThread(v3, jobs);
+	auto runTask = [&v3, &jobs](Task& task, Counters& mine) {
+		if(auto* job = std::get_if<Job>(&task)) {
+			quickSortMThread(v3, job->from, job->to, job->badAllowed, jobs, mine);
+			bump(mine.finished);              // Finish the job. Increase this thread's indicator.
+		} else {
+			std::get<std::shared_ptr<BlockJob>>(task)->work();   // Help with a parallelPartition step.
+			task = Job{};
+		}
+	};
+	for(int i = 0; i < thread_num; i++){
+		workers[i] = std::thread([&jobs, &runTask, &mine = counters[i]](){
+			Task task;
+			while(jobs.WaitAndDequeue(task)){  // Do the task with dequeue.
+				runTask(task, mine);
+			}
+		});
+	}
+	// Waiting until all the works are finished.
+	// while(remains != 0) std::this_thread::yield(); would be busy waiting: it burns a core and only
+	// yields it to the workers. Optimization 3: main helps with the queued jobs instead, and when the
+	// queue is empty it sleeps on the queue like a worker until a new job arrives or the last worker
+	// to run out of jobs sees that everything is done.
+	{
+		Task task;
+		while(jobs.WaitAndDequeue(task, [&counters] { return allDone(counters); })) {
+			runTask(task, counters[thread_num]);
+		}
+	}
+	jobs.Close();
+
+	for(auto& w: workers){
+		w.join();
+	}
+
+    /* std::sort with C++20 parallelized sorting (compiler or library supported required) */
+    auto start = std::chrono::steady_clock::now();
+    std::sort(v4.begin(), v4.end());
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Default: \t" << (end - start).count() << "ns" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    std::sort(std::execution::seq, v4.begin(), v4.end());
+    end = std::chrono::steady_clock::now();
+    std::cout << "seq: \t\t" << (end - start).count() << "ns" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    std::sort(std::execution::par, v4.begin(), v4.end());
+    end = std::chrono::steady_clock::now();
+    std::cout << "par: \t\t" << (end - start).count() << "ns" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    std::sort(std::execution::par_unseq, v4.begin(), v4.end());
+    end = std::chrono::steady_clock::now();
+    std::cout << "par_unseq: \t" << (end - start).count() << "ns" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    std::sort(std::execution::unseq, v4.begin(), v4.end());
+    end = std::chrono::steady_clock::now();
+    std::cout << "unseq: \t\t" << (end - start).count() << "ns" << std::endl;
+
+    /* Single-threaded Quick Sort over input patterns (sorted and reversed used to be O(n^2)) */
+    std::mt19937 gen(0);
+    std::vector<std::pair<const char*, std::function<int(int)>>> patterns = {
+        {"random:     ", [&](int) { return (int)(gen() % size); }},
+        {"sorted:     ", [&](int i) { return i; }},
+        {"reversed:   ", [&](int i) { return size - i; }},
+        {"organ-pipe: ", [&](int i) { return std::min(i, size - i); }},
+        {"few-unique: ", [&](int) { return (int)(gen() % 16); }},
+    };
+    for(auto& [name, make] : patterns) {
+        std::vector<int> v5(size);
+        for(int i = 0; i < size; i++) v5[i] = make(i);
+        std::vector<int> v6 = v5;
+        start = std::chrono::steady_clock::now();
+        quickSort(v5);
+        end = std::chrono::steady_clock::now();
+        std::cout << name << "quickSort " << (end - start).count() << "ns";
+        start = std::chrono::steady_clock::now();
+        std::sort(v6.begin(), v6.end());
+        end = std::chrono::steady_clock::now();
+        std::cout << ", std::sort " << (end - start).count() << "ns" << (v5 == v6 ? "" : " (WRONG)") << std::endl;
+    }
+
+    /* Print the results. */
+	for(int x: v1) {
+		std::cout << x << " ";
+	}
+	std::cout << std::endl;
+
+	for(int x: v2) {
+		std::cout << x << " ";
+	}
+	std::cout << std::endl;
+
+	for(int x: v3) {
+		std::cout << x << " ";
+	}
+	std::cout << std::endl;
+
+	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+// 編譯參數： -std=c++20 -O2
+// 1. 原本的thread pool在一開始就固定開好worker，閒置的時候浪費記憶體(每條thread的stack)以及排程器的時間，
+//    而當任務卡在I/O (blocking)時又沒辦法多開幾條來補上。
+// 2. ElasticThreadPool：由一條controller執行緒每隔一段時間(tick)檢查佇列的狀態，
+//    a. 佇列深度(queue depth)超過grow_depth，或是最久的任務已經等了超過grow_wait，就多開一條worker
+//       (不超過max_workers)。
+//    b. worker閒置超過idle_timeout就自己退休(不低於min_workers)。
+//    c. 退休是合作式的(cooperative)：和Jthread_Cpp20.cpp一樣使用std::jthread以及std::stop_token，
+//       controller不會強制殺掉任何worker，而是由worker在沒事做時自己檢查並結束；
+//       解構pool時對所有worker request_stop()，std::condition_variable_any的wait會被stop_token叫醒。
+// 3. size()回傳目前worker的數量，events()回傳所有調整大小(resize)的紀錄(時間、grow/retire、調整後的大小)。
+// 4. main模擬一段會阻塞(sleep)的I/O任務尖峰，之後閒置，觀察pool放大再縮小的過程。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <list>
+#include <thread>
+#include <stop_token>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+class ElasticThreadPool{
+public:
+    struct Options{
+        int min_workers = 1;
+        int max_workers = 64;
+        std::size_t grow_depth = 4;                 // 佇列深度超過此值 -> 多開一條
+        Clock::duration grow_wait = 5ms;            // 最久的任務等待超過此值 -> 多開一條
+        Clock::duration idle_timeout = 200ms;       // worker閒置超過此值 -> 退休
+        Clock::duration tick = 1ms;                 // controller檢查的間隔
+    };
+
+    struct ResizeEvent{
+        Clock::time_point when;
+        bool grow;
+        int size;                                   // 調整後的worker數量
+    };
+
+private:
+    struct Item{
+        std::function<void()> task;
+        Clock::time_point enqueued;
+    };
+
+    Options opt_;
+    std::deque<Item> dq_;
+    std::mutex m;
+    std::condition_variable_any cv;
+    std::list<std::jthread> workers;                // 退休的worker由controller回收(join)
+    std::vector<std::list<std::jthread>::iterator> retired;
+    int size_ = 0;                                  // 目前的worker數量 (受m保護)
+    int idle_ = 0;                                  // 正在等任務的worker數量 (受m保護)
+    std::vector<ResizeEvent> events_;
+    std::jthread controller;
+
+    // 需持有m
+    void spawn_locked(){
+        size_++;
+        events_.push_back({Clock::now(), true, size_});
+        workers.emplace_back();
+        auto it = std::prev(workers.end());
+        *it = std::jthread{[this, it](std::stop_token token){ worker_loop(token, it); }};
+    }
+
+    void worker_loop(std::stop_token token, std::list<std::jthread>::iterator self){
+        std::unique_lock<std::mutex> uk(m);
+        while(true){
+            idle_++;
+            bool got = cv.wait_for(uk, token, opt_.idle_timeout, [this]{ return !dq_.empty(); });
+            idle_--;
+            if(!got){
+                if(token.stop_requested()) return;
+                if(size_ > opt_.min_workers){       // 閒置太久：合作式退休
+                    size_--;
+                    events_.push_back({Clock::now(), false, size_});
+                    retired.push_back(self);
+                    return;
+                }
+                continue;
+            }
+            Item item = std::move(dq_.front());
+            dq_.pop_front();
+            uk.unlock();
+            item.task();
+            uk.lock();
+        }
+    }
+
+    void control(std::stop_token token){
+        while(!token.stop_requested()){
+            std::this_thread::sleep_for(opt_.tick);
+            std::vector<std::jthread> done;
+            {
+                std::lock_guard<std::mutex> lk(m);
+                for(auto it: retired){               // 把已經退休的worker從list中拿出來，在鎖外join
+                    done.push_back(std::move(*it));
+                    workers.erase(it);
+                }
+                retired.clear();
+                if(dq_.empty() || size_ >= opt_.max_workers || idle_ > 0) continue;
+                bool deep = dq_.size() > opt_.grow_depth;
+                bool slow = Clock::now() - dq_.front().enqueued > opt_.grow_wait;
+                if(deep || slow) spawn_locked();
+            }
+        }
+    }
+
+public:
+    explicit ElasticThreadPool(Options opt): opt_(opt){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            for(int i = 0; i < opt_.min_workers; i++) spawn_locked();
+        }
+        controller = std::jthread{[this](std::stop_token token){ control(token); }};
+    }
+    ElasticThreadPool(): ElasticThreadPool(Options{}){}
+
+    ~ElasticThreadPool(){
+        controller.request_stop();
+        controller.join();
+        std::list<std::jthread> all;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            all.swap(workers);
+            retired.clear();
+        }
+        for(auto& w: all) w.request_stop();           // 叫醒等待中的worker並讓它們結束
+        // std::jthread解構時自動join
+    }
+
+    template<typename F>
+    void post(F&& f){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back({std::forward<F>(f), Clock::now()});
+        }
+        cv.notify_one();
+    }
+
+    int size(){
+        std::lock_guard<std::mutex> lk(m);
+        return size_;
+    }
+
+    std::vector<ResizeEvent> events(){
+        std::lock_guard<std::mutex> lk(m);
+        return events_;
+    }
+};
+
+int main(){
+    auto t0 = Clock::now();
+    ElasticThreadPool::Options opt;
+    opt.min_workers = 1;
+    opt.max_workers = 16;
+    opt.idle_timeout = 100ms;
+    ElasticThreadPool pool(opt);
+
+    std::atomic<int> done{0};
+    for(int i = 0; i < 64; i++){
+        pool.post([&done]{
+            std::this_thread::sleep_for(20ms);          // 模擬阻塞的I/O
+            done++;
+        });
+    }
+    while(done < 64){
+        std::this_thread::sleep_for(10ms);
+    }
+    std::cout << "64 blocking tasks done at +"
+              << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count()
+              << " ms, size after burst: " << pool.size() << std::endl;
+
+    std::this_thread::sleep_for(500ms);                 // 閒置，讓worker退休
+    std::cout << "size after idle: " << pool.size() << std::endl;
+
+    std::cout << "resize events:" << std::endl;
+    for(const auto& e: pool.events()){
+        std::cout << "  +" << std::chrono::duration_cast<std::chrono::milliseconds>(e.when - t0).count() << " ms\t"
+                  << (e.grow ? "grow  " : "retire") << "\tsize = " << e.size << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+// 編譯參數： -std=c++20 -O2 (Linux only, 需要futex system call)
+// 1. 原本的WaitandDequeue一發現佇列是空的就直接cv.wait，worker沒事做時一定會進kernel睡覺，
+//    就算下一個任務在幾微秒(us)之後就來了，也要付出一次完整的「睡覺 + 被kernel叫醒」的成本。
+// 2. 把「怎麼等」抽出來變成可替換的wait strategy，Queue<T, Wait>在佇列是空的時候交給Wait處理：
+//    a. CvWait      -> 與原本相同，直接在condition_variable上睡覺。
+//    b. FutexWait   -> 混合式(hybrid)等待：先自旋一小段時間(每次迴圈執行pause指令，降低耗電以及
+//                      對另一個hyperthread的干擾)，再yield幾次，最後才使用Linux futex睡覺。
+//                      生產者只有在真的有人睡在futex上(waiters > 0)時才需要呼叫futex wake (system call)。
+//    c. BusyPoll    -> 永遠不睡覺，一直自旋檢查，延遲最低但會吃滿一整個核心，
+//                      通常搭配pin_to_cpu()把對延遲敏感(latency-critical)的worker固定在某個核心上。
+// 3. 等待的條件(佇列不是空的或已經Close)使用atomic的size_以及closed檢查，不需要拿mutex。
+// 4. main為wakeup latency benchmark：量測從Enqueue到worker開始執行之間的時間(p50/p99)，比較三種模式。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+using namespace std::literals;
+
+static long futex_wait(std::atomic<std::uint32_t>* addr, std::uint32_t expected){
+    return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static long futex_wake(std::atomic<std::uint32_t>* addr, int count){
+    return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+// 把目前的執行緒固定在指定的CPU上，成功回傳true。
+bool pin_to_cpu(int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+class CvWait{
+    std::mutex m;
+    std::condition_variable cv;
+public:
+    template<typename Pred>
+    void wait(Pred ready){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, ready);
+    }
+    void notify_one(){
+        { std::lock_guard<std::mutex> lk(m); }   // 確保等待的一方不是卡在「檢查完條件但還沒睡著」之間
+        cv.notify_one();
+    }
+    void notify_all(){
+        { std::lock_guard<std::mutex> lk(m); }
+        cv.notify_all();
+    }
+};
+
+class FutexWait{
+    alignas(64) std::atomic<std::uint32_t> seq{0};   // futex word：每次notify都+1
+    std::atomic<int> waiters{0};
+public:
+    static constexpr int spin_limit = 2000;           // pause的次數 (約數十微秒)
+    static constexpr int yield_limit = 16;
+
+    template<typename Pred>
+    void wait(Pred ready){
+        for(int i = 0; i < spin_limit; i++){
+            if(ready()) return;
+            CPU_RELAX();
+        }
+        for(int i = 0; i < yield_limit; i++){
+            if(ready()) return;
+            std::this_thread::yield();
+        }
+        while(true){
+            std::uint32_t s = seq.load(std::memory_order_acquire);
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            if(ready()){
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            futex_wait(&seq, s);                      // seq已經不是s的話kernel會直接返回(不會漏掉叫醒)
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+            if(ready()) return;
+        }
+    }
+    void notify_one(){
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        if(waiters.load(std::memory_order_seq_cst) > 0) futex_wake(&seq, 1);
+    }
+    void notify_all(){
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        if(waiters.load(std::memory_order_seq_cst) > 0) futex_wake(&seq, INT_MAX);
+    }
+};
+
+class BusyPoll{
+public:
+    template<typename Pred>
+    void wait(Pred ready){
+        while(!ready()) CPU_RELAX();
+    }
+    void notify_one(){}
+    void notify_all(){}
+};
+
+template<typename T, typename Wait = CvWait>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::atomic<std::size_t> size_{0};
+    Wait w;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+            size_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        w.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        while(true){
+            {
+                std::lock_guard<std::mutex> lk(m);
+                if(!dq_.empty()){
+                    value = std::move(dq_.front());
+                    dq_.pop_front();
+                    size_.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if(closed.load()) return false;
+            }
+            w.wait([this]{ return size_.load(std::memory_order_seq_cst) > 0 || closed.load(); });
+        }
+    }
+    void Close(){
+        closed.store(true);
+        w.notify_all();
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+// 量測wakeup latency：每次Enqueue一個時間戳記，worker拿到後記錄延遲。
+// 兩次Enqueue之間先間隔一段時間，讓worker進入「沒事做」的狀態。
+template<typename Wait>
+void bench(const char* name, int workers_num, int samples, bool pin){
+    Queue<Clock::time_point, Wait> q;
+    std::vector<std::vector<long long>> latencies(workers_num);
+    std::vector<std::thread> workers;
+    int cpus = std::thread::hardware_concurrency();
+    for(int i = 0; i < workers_num; i++){
+        workers.push_back(std::thread{[&, i]{
+            if(pin) pin_to_cpu((i + 1) % cpus);       // CPU 0 留給生產者
+            Clock::time_point ts;
+            while(q.WaitandDequeue(ts)){
+                latencies[i].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - ts).count());
+            }
+        }});
+    }
+    std::thread producer{[&]{                        // 獨立的thread，pin的時候不會改到呼叫端的affinity
+        if(pin) pin_to_cpu(0);
+        for(int i = 0; i < samples; i++){
+            std::this_thread::sleep_for(200us);
+            q.Enqueue(Clock::now());
+        }
+    }};
+    producer.join();
+    q.Close();
+    for(auto& t: workers){
+        t.join();
+    }
+
+    std::vector<long long> all;
+    for(auto& l: latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p){ return all[std::min(all.size() - 1, (std::size_t)(p * all.size()))]; };
+    std::cout << name << "\tp50: " << pct(0.50) / 1000.0 << " us\tp99: " << pct(0.99) / 1000.0 << " us" << std::endl;
+}
+
+int main(){
+    int thread_num = std::thread::hardware_concurrency();
+    int workers_num = std::max(1, thread_num - 1);    // 保留一個核心給生產者
+    std::cout << "Avaliable Threads: " << thread_num << ", workers: " << workers_num << std::endl;
+
+    constexpr int samples = 2000;
+    bench<CvWait>("cv", workers_num, samples, false);
+    bench<FutexWait>("futex", workers_num, samples, false);
+    bench<BusyPoll>("spin", workers_num, samples, thread_num > 1);  // 只有一個核心時pin沒有意義
+
+    return 0;
+}
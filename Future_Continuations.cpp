@@ -0,0 +1,394 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Future_and_Promise.cpp以及Course Notes中的futures_and_promises.cpp都只能用f.get()拿結果，
+//    get()會把呼叫的執行緒停在那邊等，每一個還沒完成的結果都要佔住一條執行緒；
+//    Vector_Map_Reduce_with_Tasks.cpp的async_res就是在迴圈中一個一個get()。
+// 2. Future<T>：
+//    a. then(f)：結果出來的時候，由「完成的那一方」把f(value)丟到pool上執行，回傳代表f結果的Future，
+//       可以一直串下去(f.then(...).then(...))，中間沒有任何執行緒在等。
+//       前面的步驟丟出例外時，f不會被呼叫，例外直接傳給下一個Future。
+//    b. when_all(futures)：全部完成時得到std::vector<T>；when_any(futures)：第一個完成時得到(index, value)。
+//       輸入是空的時候，when_all立刻得到空的vector，when_any立刻以std::invalid_argument結束。
+//       兩者都只是掛在每個輸入上的一小段callback(以atomic計數/搶旗標)，直接在完成的執行緒上執行，
+//       不需要任何執行緒阻塞(block)等待。
+//    c. SharedState<T>保存結果以及「完成以後要做的事(callbacks)」，以std::shared_ptr在Promise、Future以及
+//       continuation之間共用；mutex只在登記callback以及設定結果的那一瞬間使用。
+//    d. get()仍然保留，給最後真的需要同步等待結果的地方(例如main)使用。
+// 3. main：then/when_any/例外傳遞的示範，以及fan-out/fan-in的延遲benchmark，
+//    與Vector_Map_Reduce_with_Tasks.cpp的「std::async + get()迴圈」比較。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <future>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <variant>
+#include <exception>
+#include <stdexcept>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <type_traits>
+#include <utility>
+#include <cmath>
+
+using namespace std::literals;
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+class ThreadPool{
+    Queue<std::function<void()>> Jobs;
+    std::vector<std::thread> workers;
+public:
+    explicit ThreadPool(int thread_num){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this]{
+                std::function<void()> task;
+                while(Jobs.WaitandDequeue(task)){
+                    task();
+                }
+            }});
+        }
+    }
+    ~ThreadPool(){
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+
+    template<typename F>
+    void post(F&& f){ Jobs.Enqueue(std::forward<F>(f)); }
+
+    template<typename F>
+    auto submit(F&& f);
+};
+
+template<typename T>
+class SharedState{
+    struct Callback{
+        std::function<void()> f;
+        bool run_inline;            // true：直接在完成的執行緒上執行 (只給內部的小工作使用)
+    };
+
+    ThreadPool& pool_;
+    std::mutex m;
+    std::condition_variable cv;
+    bool ready_ = false;
+    std::optional<T> value_;
+    std::exception_ptr error_;
+    std::vector<Callback> callbacks_;
+
+    template<typename Set>
+    void complete(Set set){
+        std::vector<Callback> cbs;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            set();
+            ready_ = true;
+            cbs.swap(callbacks_);
+        }
+        cv.notify_all();
+        for(auto& cb: cbs) dispatch(std::move(cb));
+    }
+
+    void dispatch(Callback cb){
+        if(cb.run_inline) cb.f();
+        else pool_.post(std::move(cb.f));
+    }
+
+public:
+    explicit SharedState(ThreadPool& pool): pool_(pool){}
+
+    ThreadPool& pool() const { return pool_; }
+
+    void set_value(T v){ complete([&]{ value_.emplace(std::move(v)); }); }
+    void set_exception(std::exception_ptr e){ complete([&]{ error_ = e; }); }
+
+    // 完成的時候呼叫f；已經完成的話立刻呼叫(或丟到pool)。
+    void on_ready(std::function<void()> f, bool run_inline = false){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if(!ready_){
+                callbacks_.push_back({std::move(f), run_inline});
+                return;
+            }
+        }
+        dispatch({std::move(f), run_inline});
+    }
+
+    bool is_ready(){
+        std::lock_guard<std::mutex> lk(m);
+        return ready_;
+    }
+
+    void wait(){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{ return ready_; });
+    }
+
+    // 以下只能在完成以後呼叫
+    std::exception_ptr error() const { return error_; }
+    T take(){ return std::move(*value_); }
+};
+
+template<typename T>
+class Future{
+    std::shared_ptr<SharedState<T>> s_;
+public:
+    Future() = default;
+    explicit Future(std::shared_ptr<SharedState<T>> s): s_(std::move(s)){}
+    Future(Future&&) noexcept = default;
+    Future& operator=(Future&&) noexcept = default;
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    bool valid() const { return s_ != nullptr; }
+    bool is_ready() const { return s_->is_ready(); }
+
+    const std::shared_ptr<SharedState<T>>& state() const { return s_; }   // 給when_all/when_any使用
+
+    T get(){
+        auto s = std::move(s_);
+        s->wait();
+        if(s->error()) std::rethrow_exception(s->error());
+        return s->take();
+    }
+
+    // 結果出來時在pool上執行f(value)。f回傳void時，得到的是Future<std::monostate>。
+    template<typename F>
+    auto then(F&& f){
+        using R = std::invoke_result_t<std::decay_t<F>, T>;
+        using U = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+        auto s = std::move(s_);
+        auto next = std::make_shared<SharedState<U>>(s->pool());
+        s->on_ready([s, next, f = std::forward<F>(f)]() mutable{
+            if(s->error()){                               // 前面的例外直接往下傳
+                next->set_exception(s->error());
+                return;
+            }
+            try{
+                if constexpr(std::is_void_v<R>){
+                    f(s->take());
+                    next->set_value({});
+                }else{
+                    next->set_value(f(s->take()));
+                }
+            }catch(...){
+                next->set_exception(std::current_exception());
+            }
+        });
+        return Future<U>{next};
+    }
+};
+
+// f回傳void時，與then相同，得到的是Future<std::monostate>。
+template<typename F>
+auto ThreadPool::submit(F&& f){
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    using U = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+    auto s = std::make_shared<SharedState<U>>(*this);
+    post([s, f = std::forward<F>(f)]() mutable{
+        try{
+            if constexpr(std::is_void_v<R>){
+                f();
+                s->set_value({});
+            }else{
+                s->set_value(f());
+            }
+        }catch(...){
+            s->set_exception(std::current_exception());
+        }
+    });
+    return Future<U>{s};
+}
+
+template<typename T>
+Future<std::vector<T>> when_all(ThreadPool& pool, std::vector<Future<T>> futures){
+    struct Join{
+        std::vector<std::optional<T>> results;
+        std::atomic<std::size_t> left;
+        std::atomic<bool> failed{false};
+        std::shared_ptr<SharedState<std::vector<T>>> out;
+    };
+    auto j = std::make_shared<Join>();
+    j->results.resize(futures.size());
+    j->left.store(futures.size());
+    j->out = std::make_shared<SharedState<std::vector<T>>>(pool);
+    if(futures.empty()) j->out->set_value({});
+    for(std::size_t i = 0; i < futures.size(); i++){
+        auto s = futures[i].state();
+        s->on_ready([j, s, i]{
+            if(s->error()){
+                if(!j->failed.exchange(true)) j->out->set_exception(s->error());   // 只回報第一個例外
+            }else{
+                j->results[i].emplace(s->take());
+            }
+            if(j->left.fetch_sub(1, std::memory_order_acq_rel) == 1 && !j->failed.load()){
+                std::vector<T> v;
+                v.reserve(j->results.size());
+                for(auto& r: j->results) v.push_back(std::move(*r));
+                j->out->set_value(std::move(v));
+            }
+        }, true);
+    }
+    return Future<std::vector<T>>{j->out};
+}
+
+template<typename T>
+Future<std::pair<std::size_t, T>> when_any(ThreadPool& pool, std::vector<Future<T>> futures){
+    struct Race{
+        std::atomic<bool> done{false};
+        std::shared_ptr<SharedState<std::pair<std::size_t, T>>> out;
+    };
+    auto r = std::make_shared<Race>();
+    r->out = std::make_shared<SharedState<std::pair<std::size_t, T>>>(pool);
+    if(futures.empty()){                                  // 沒有人會完成：立刻以例外結束，不要永遠等下去
+        r->out->set_exception(std::make_exception_ptr(std::invalid_argument("when_any: no futures")));
+    }
+    for(std::size_t i = 0; i < futures.size(); i++){
+        auto s = futures[i].state();
+        s->on_ready([r, s, i]{
+            if(r->done.exchange(true)) return;            // 已經有別人先完成了
+            if(s->error()) r->out->set_exception(s->error());
+            else r->out->set_value({i, s->take()});
+        }, true);
+    }
+    return Future<std::pair<std::size_t, T>>{r->out};
+}
+
+double accum(const double* beg, const double* end){
+    return std::accumulate(beg, end, 0.0);
+}
+
+// Vector_Map_Reduce_with_Tasks.cpp的async_res：每個chunk一個std::async，再一個一個get()。
+double async_get_loop(const std::vector<double>& data, int chunks){
+    std::size_t range_ = (data.size() + chunks - 1) / chunks;
+    std::vector<std::future<double>> Results;
+    for(int i = 0; i < chunks; i++){
+        const double* beg = data.data() + std::min(data.size(), i * range_);
+        const double* end = data.data() + std::min(data.size(), (i + 1) * range_);
+        Results.push_back(std::async(std::launch::async, accum, beg, end));
+    }
+    double sum = 0.0;
+    for(auto& res: Results){
+        sum += res.get();
+    }
+    return sum;
+}
+
+// 同樣丟到pool上，但呼叫端仍然一個一個get()。
+double pool_get_loop(ThreadPool& pool, const std::vector<double>& data, int chunks){
+    std::size_t range_ = (data.size() + chunks - 1) / chunks;
+    std::vector<Future<double>> Results;
+    for(int i = 0; i < chunks; i++){
+        const double* beg = data.data() + std::min(data.size(), i * range_);
+        const double* end = data.data() + std::min(data.size(), (i + 1) * range_);
+        Results.push_back(pool.submit([beg, end]{ return accum(beg, end); }));
+    }
+    double sum = 0.0;
+    for(auto& res: Results){
+        sum += res.get();
+    }
+    return sum;
+}
+
+// fan-in由when_all以及then完成，不需要任何執行緒等待；回傳代表總和的Future。
+Future<double> pool_when_all(ThreadPool& pool, const std::vector<double>& data, int chunks){
+    std::size_t range_ = (data.size() + chunks - 1) / chunks;
+    std::vector<Future<double>> Results;
+    for(int i = 0; i < chunks; i++){
+        const double* beg = data.data() + std::min(data.size(), i * range_);
+        const double* end = data.data() + std::min(data.size(), (i + 1) * range_);
+        Results.push_back(pool.submit([beg, end]{ return accum(beg, end); }));
+    }
+    return when_all(pool, std::move(Results)).then([](std::vector<double> parts){
+        return std::accumulate(parts.begin(), parts.end(), 0.0);
+    });
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+    ThreadPool pool(thread_num);
+
+    // then的串接
+    auto f = pool.submit([]{ return 6; })
+                 .then([](int x){ return x * 7; })
+                 .then([](int x){ return "answer = " + std::to_string(x); });
+    std::cout << f.get() << std::endl;
+
+    // when_any：第一個完成的結果
+    {
+        std::vector<Future<int>> fs;
+        for(int i = 0; i < 3; i++){
+            fs.push_back(pool.submit([i]{
+                std::this_thread::sleep_for(std::chrono::milliseconds(30 * (3 - i)));
+                return i * 100;
+            }));
+        }
+        auto [index, value] = when_any(pool, std::move(fs)).get();
+        std::cout << "when_any: future " << index << " finished first with " << value << std::endl;
+    }
+
+    // 例外沿著then往下傳，中間的continuation不會被呼叫
+    try{
+        pool.submit([]() -> int { throw std::runtime_error("failed in the first step"); })
+            .then([](int x){ std::cout << "never printed" << std::endl; return x; })
+            .get();
+    }catch(const std::exception& e){
+        std::cout << "caught: " << e.what() << std::endl;
+    }
+
+    // Benchmark：fan-out/fan-in的延遲 (從送出第一個chunk到拿到總和)
+    int vec_sz = argc > 1 ? std::stoi(argv[1]) : 1 << 20;
+    std::vector<double> vec(vec_sz);
+    std::mt19937 mt{};
+    for(auto& v: vec) v = mt() % 1000;
+    constexpr int chunks = 64, rounds = 100;
+
+    auto measure = [&](const char* name, auto&& fn){
+        double sum = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for(int r = 0; r < rounds; r++) sum = fn();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "  " << name << std::chrono::duration<double, std::micro>(end - start).count() / rounds
+                  << " us (sum = " << sum << ")" << std::endl;
+    };
+    std::cout << "fan-out/fan-in of " << chunks << " chunks over " << vec_sz << " doubles, latency per round:" << std::endl;
+    measure("std::async + get() loop: ", [&]{ return async_get_loop(vec, chunks); });
+    measure("pool.submit + get() loop: ", [&]{ return pool_get_loop(pool, vec, chunks); });
+    measure("when_all().then():       ", [&]{ return pool_when_all(pool, vec, chunks).get(); });
+
+    return 0;
+}
@@ -0,0 +1,407 @@
+// 編譯參數： -std=c++20 -O2
+// 1. pool變慢的時候完全看不到裡面發生什麼事：Queue<T>不會告訴我們目前的深度(depth)、任務在佇列中等了多久
+//    才被拿出來(sojourn time)、WaitandDequeue卡了多久，worker也不會回報忙碌(busy)以及閒置(idle)的時間。
+// 2. 低成本(low-overhead)的計數器：
+//    a. 每條執行緒在每個Queue中都有自己的一份計數器(thread-local slot，由PerThread<Slot>管理)，
+//       只有自己會寫入，因此不需要lock，也不需要fetch_add這種會鎖住cache line的read-modify-write，
+//       只用relaxed的load + store (bump)。
+//    b. 計數器仍然是std::atomic，其他執行緒可以隨時以relaxed load讀取而不會有data race，
+//       snapshot()把所有slot加總起來，不需要停下worker，也不需要拿佇列的mutex。
+//    c. 延遲使用以2為底的對數分桶直方圖(log-bucketed histogram)：第b個桶子記錄[2^(b-1), 2^b) ns，
+//       65個桶子涵蓋整個uint64_t，記錄一次只需要一個std::bit_width，百分位數(percentile)的誤差在2倍以內。
+//    d. 每個worker有自己一份(對齊cache line，避免false sharing)的busy/idle時間以及任務執行時間的直方圖，
+//       busy_since記錄目前任務的開始時間，snapshot時也會把「正在執行中」的時間算進去。
+// 3. Queue<T, Instrument>：Instrument = false時與原本的Queue相同(不讀時鐘也不寫計數器)，
+//    用來量測instrumentation本身的成本。
+// 4. main：一條monitor執行緒每100ms讀一次snapshot並印出，最後比較有/沒有instrumentation時每個任務的成本。
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <array>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <bit>
+#include <cstdint>
+#include <set>
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+// 只有單一寫入者(single writer)的計數器：relaxed load + store，其他執行緒以relaxed load讀取。
+inline void bump(std::atomic<std::uint64_t>& c, std::uint64_t v = 1){
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+inline std::uint64_t to_ns(Clock::duration d){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+struct Histogram{
+    static constexpr int buckets = 65;              // std::bit_width(uint64_t)為0 ~ 64
+    std::array<std::atomic<std::uint64_t>, buckets> count{};
+    std::atomic<std::uint64_t> sum{0};
+
+    void record(std::uint64_t ns){
+        bump(count[std::bit_width(ns)]);
+        bump(sum, ns);
+    }
+};
+
+struct HistogramSnapshot{
+    std::array<std::uint64_t, Histogram::buckets> count{};
+    std::uint64_t sum = 0;
+
+    void add(const Histogram& h){
+        for(int b = 0; b < Histogram::buckets; b++) count[b] += h.count[b].load(std::memory_order_relaxed);
+        sum += h.sum.load(std::memory_order_relaxed);
+    }
+    std::uint64_t total() const {
+        std::uint64_t n = 0;
+        for(auto c: count) n += c;
+        return n;
+    }
+    double mean() const {
+        std::uint64_t n = total();
+        return n ? (double)sum / n : 0.0;
+    }
+    // 回傳第p百分位所在桶子的上界(ns)
+    std::uint64_t percentile(double p) const {
+        std::uint64_t n = total();
+        if(n == 0) return 0;
+        std::uint64_t rank = std::max<std::uint64_t>(1, (std::uint64_t)(p * n + 0.5)), seen = 0;
+        for(int b = 0; b < Histogram::buckets; b++){
+            seen += count[b];
+            if(seen >= rank) return b == 0 ? 0 : (b >= 64 ? UINT64_MAX : (std::uint64_t{1} << b) - 1);
+        }
+        return UINT64_MAX;
+    }
+};
+
+// 每條執行緒一個Slot，第一次使用時註冊(需要拿m)，之後只查thread_local的快取。
+// id在所有PerThread物件之間是唯一的，所以舊物件留在快取中的項目不會被誤用；
+// 解構時把id從live中移除，之後這條執行緒第一次註冊新的物件時順便把已經解構的項目清掉，快取不會無限增長。
+template<typename Slot>
+class PerThread{
+    std::mutex m;
+    std::deque<Slot> slots_;                        // std::deque在尾端加入元素時不會讓已有元素的位址失效
+    std::uint64_t id_;
+
+    struct Registry{
+        std::mutex m;
+        std::uint64_t next = 0;
+        std::set<std::uint64_t> live;
+    };
+    static Registry& registry(){
+        static Registry r;
+        return r;
+    }
+public:
+    PerThread(){
+        auto& r = registry();
+        std::lock_guard<std::mutex> lk(r.m);
+        id_ = ++r.next;
+        r.live.insert(id_);
+    }
+    ~PerThread(){
+        auto& r = registry();
+        std::lock_guard<std::mutex> lk(r.m);
+        r.live.erase(id_);
+    }
+    PerThread(const PerThread&) = delete;
+    PerThread& operator=(const PerThread&) = delete;
+
+    Slot& local(){
+        thread_local std::vector<std::pair<std::uint64_t, Slot*>> cache;
+        for(auto& [id, slot]: cache){
+            if(id == id_) return *slot;
+        }
+        {
+            auto& r = registry();
+            std::lock_guard<std::mutex> lk(r.m);
+            std::erase_if(cache, [&r](const auto& e){ return !r.live.contains(e.first); });
+        }
+        Slot* slot;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            slot = &slots_.emplace_back();
+        }
+        cache.emplace_back(id_, slot);
+        return *slot;
+    }
+
+    template<typename F>
+    void for_each(F f){
+        std::lock_guard<std::mutex> lk(m);
+        for(const auto& slot: slots_) f(slot);
+    }
+};
+
+struct alignas(64) QueueSlot{
+    std::atomic<std::uint64_t> enqueued{0};
+    std::atomic<std::uint64_t> dequeued{0};
+    Histogram sojourn;                              // Enqueue -> 被拿出來
+    Histogram wait;                                 // WaitandDequeue從呼叫到返回
+};
+
+template<typename T, bool Instrument = true>
+class Queue{
+    struct Item{
+        T value;
+        Clock::time_point enqueued;
+    };
+    std::deque<Item> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+    std::atomic<std::size_t> depth_{0};             // 只在持有m時寫入，其他執行緒可以隨時讀
+    std::atomic<std::size_t> max_depth_{0};
+    PerThread<QueueSlot> stats_;
+
+    static Clock::time_point now(){
+        if constexpr(Instrument) return Clock::now();
+        else return {};
+    }
+public:
+    struct Snapshot{
+        std::size_t depth = 0;
+        std::size_t max_depth = 0;
+        std::uint64_t enqueued = 0;
+        std::uint64_t dequeued = 0;
+        HistogramSnapshot sojourn;
+        HistogramSnapshot wait;
+    };
+
+    void Enqueue(T val){
+        auto t = now();
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back({std::move(val), t});
+            if constexpr(Instrument){
+                std::size_t d = dq_.size();
+                depth_.store(d, std::memory_order_relaxed);
+                if(d > max_depth_.load(std::memory_order_relaxed)) max_depth_.store(d, std::memory_order_relaxed);
+            }
+        }
+        if constexpr(Instrument) bump(stats_.local().enqueued);
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        auto start = now();
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        Item item = std::move(dq_.front());
+        dq_.pop_front();
+        if constexpr(Instrument) depth_.store(dq_.size(), std::memory_order_relaxed);
+        uk.unlock();
+        value = std::move(item.value);
+        if constexpr(Instrument){
+            auto end = Clock::now();
+            QueueSlot& s = stats_.local();
+            bump(s.dequeued);
+            s.wait.record(to_ns(end - start));
+            s.sojourn.record(to_ns(end - item.enqueued));
+        }
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+
+    // 可以在任何執行緒呼叫，不會擋住Enqueue以及WaitandDequeue。
+    Snapshot snapshot(){
+        Snapshot s;
+        s.depth = depth_.load(std::memory_order_relaxed);
+        s.max_depth = max_depth_.load(std::memory_order_relaxed);
+        stats_.for_each([&s](const QueueSlot& slot){
+            s.enqueued += slot.enqueued.load(std::memory_order_relaxed);
+            s.dequeued += slot.dequeued.load(std::memory_order_relaxed);
+            s.sojourn.add(slot.sojourn);
+            s.wait.add(slot.wait);
+        });
+        return s;
+    }
+};
+
+struct alignas(64) WorkerStats{
+    std::atomic<std::uint64_t> tasks{0};
+    std::atomic<std::uint64_t> busy_ns{0};
+    std::atomic<std::uint64_t> idle_ns{0};
+    std::atomic<std::int64_t> busy_since{0};        // 正在執行的任務的開始時間 (0 = 閒置中)
+    Histogram task_time;
+};
+
+struct WorkerSnapshot{
+    std::uint64_t tasks = 0;
+    std::uint64_t busy_ns = 0;
+    std::uint64_t idle_ns = 0;
+    bool busy = false;
+    HistogramSnapshot task_time;
+
+    double utilization() const {
+        std::uint64_t t = busy_ns + idle_ns;
+        return t ? (double)busy_ns / t : 0.0;
+    }
+};
+
+template<bool Instrument = true>
+class ThreadPool{
+    Queue<std::function<void()>, Instrument> Jobs;
+    std::vector<WorkerStats> stats_;
+    std::vector<std::thread> workers;
+
+    void worker_loop(WorkerStats& st){
+        std::function<void()> task;
+        while(true){
+            if constexpr(Instrument){
+                auto t0 = Clock::now();
+                if(!Jobs.WaitandDequeue(task)) break;
+                auto t1 = Clock::now();
+                st.busy_since.store(t1.time_since_epoch().count(), std::memory_order_relaxed);
+                task();
+                auto t2 = Clock::now();
+                st.busy_since.store(0, std::memory_order_relaxed);
+                bump(st.tasks);
+                bump(st.idle_ns, to_ns(t1 - t0));
+                bump(st.busy_ns, to_ns(t2 - t1));
+                st.task_time.record(to_ns(t2 - t1));
+            }
+            else{
+                if(!Jobs.WaitandDequeue(task)) break;
+                task();
+            }
+        }
+    }
+public:
+    struct Snapshot{
+        typename Queue<std::function<void()>, Instrument>::Snapshot queue;
+        std::vector<WorkerSnapshot> workers;
+    };
+
+    explicit ThreadPool(int thread_num): stats_(thread_num){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this, i]{ worker_loop(stats_[i]); }});
+        }
+    }
+    ~ThreadPool(){
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+
+    template<typename F>
+    void post(F&& f){ Jobs.Enqueue(std::forward<F>(f)); }
+
+    Snapshot snapshot(){
+        Snapshot s;
+        s.queue = Jobs.snapshot();
+        auto now = Clock::now().time_since_epoch().count();
+        for(const auto& st: stats_){
+            WorkerSnapshot w;
+            w.tasks = st.tasks.load(std::memory_order_relaxed);
+            w.busy_ns = st.busy_ns.load(std::memory_order_relaxed);
+            w.idle_ns = st.idle_ns.load(std::memory_order_relaxed);
+            auto since = st.busy_since.load(std::memory_order_relaxed);
+            if(since != 0){                         // 把正在執行中的任務也算進busy
+                w.busy = true;
+                w.busy_ns += to_ns(Clock::duration{std::max<std::int64_t>(0, now - since)});
+            }
+            w.task_time.add(st.task_time);
+            s.workers.push_back(w);
+        }
+        return s;
+    }
+};
+
+void busy_for(Clock::duration d){
+    auto end = Clock::now() + d;
+    while(Clock::now() < end){}
+}
+
+template<bool Instrument>
+void report(ThreadPool<Instrument>& pool, Clock::time_point t0){
+    auto s = pool.snapshot();
+    std::uint64_t busy = 0, total = 0;
+    int running = 0;
+    for(const auto& w: s.workers){
+        busy += w.busy_ns;
+        total += w.busy_ns + w.idle_ns;
+        running += w.busy;
+    }
+    std::cout << "+" << std::setw(4) << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count() << " ms"
+              << "  depth " << std::setw(5) << s.queue.depth << " (max " << s.queue.max_depth << ")"
+              << "  deq " << std::setw(6) << s.queue.dequeued
+              << "  sojourn p50/p99 < " << s.queue.sojourn.percentile(0.50) / 1000 << "/" << s.queue.sojourn.percentile(0.99) / 1000 << " us"
+              << "  wait p99 < " << s.queue.wait.percentile(0.99) / 1000 << " us"
+              << "  running " << running << "/" << s.workers.size()
+              << "  util " << std::fixed << std::setprecision(1) << (total ? 100.0 * busy / total : 0.0) << "%"
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+// 每個任務只做一次atomic的加法，量測pool每個任務的成本(ns/task)。
+template<bool Instrument>
+double cost_per_task(int thread_num, int tasks){
+    std::atomic<int> done{0};
+    auto start = Clock::now();
+    {
+        ThreadPool<Instrument> pool(thread_num);
+        for(int i = 0; i < tasks; i++){
+            pool.post([&done]{ done.fetch_add(1, std::memory_order_relaxed); });
+        }
+    }
+    return (double)to_ns(Clock::now() - start) / tasks;
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+
+    // 三波負載：每一波在短時間內送出一批長短不一的任務，觀察深度以及等待時間的變化。
+    {
+        auto t0 = Clock::now();
+        ThreadPool<true> pool(thread_num);
+        std::atomic<bool> stop{false};
+        std::thread monitor{[&]{
+            while(!stop.load()){
+                std::this_thread::sleep_for(100ms);
+                report(pool, t0);
+            }
+        }};
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<int> us(10, 200);
+        for(int wave = 0; wave < 3; wave++){
+            for(int i = 0; i < 2000 * thread_num; i++){
+                pool.post([d = us(gen)]{ busy_for(std::chrono::microseconds(d)); });
+            }
+            std::this_thread::sleep_for(300ms);
+        }
+        stop.store(true);
+        monitor.join();
+
+        auto s = pool.snapshot();
+        std::cout << "per worker:" << std::endl;
+        for(std::size_t i = 0; i < s.workers.size(); i++){
+            const auto& w = s.workers[i];
+            std::cout << "  worker " << i << ": tasks " << w.tasks
+                      << ", busy " << w.busy_ns / 1000000 << " ms, idle " << w.idle_ns / 1000000 << " ms"
+                      << ", task time mean " << (int)w.task_time.mean() / 1000 << " us, p99 < " << w.task_time.percentile(0.99) / 1000 << " us"
+                      << std::endl;
+        }
+    }
+
+    int tasks = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    std::cout << "cost per task (" << tasks << " tiny tasks):" << std::endl;
+    std::cout << "  plain:        " << cost_per_task<false>(thread_num, tasks) << " ns" << std::endl;
+    std::cout << "  instrumented: " << cost_per_task<true>(thread_num, tasks) << " ns" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,233 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Simple_Thread_Pool.cpp中的Queue<T>每次Enqueue以及WaitandDequeue都要搶同一個mutex，
+//    當worker數量變多(e.g. 64核心)時，大部分的時間都花在排隊搶鎖，而不是在做事。
+// 2. 這邊實作一個有界(bounded)的多生產者多消費者(MPMC)環狀佇列(ring buffer)，
+//    API和原本的Queue<T>一樣(Enqueue / WaitandDequeue / Close)，可以直接替換。
+//    a. 每一格(cell)都帶有一個序號(sequence number)，生產者與消費者先用CAS搶到位置(head_/tail_)，
+//       再透過該格的序號來確認這一格是否已經可以寫入(或讀取)，不需要任何mutex。
+//    b. head_、tail_以及每一格都對齊到cache line (64 bytes)，避免不同執行緒更新相鄰的資料時
+//       互相讓對方的cache line失效(false sharing)。
+//    c. 只有在佇列是空的時候，消費者才會先自旋(spin)一小段時間，然後退回到condition_variable上睡覺；
+//       生產者只有在確實有人在睡覺(sleepers > 0)時才需要去拿mutex叫醒別人。
+//    d. 佇列滿了的時候Enqueue會讓出CPU(yield)直到有空位為止(backpressure)。
+// 3. 容量必須是2的次方，如此一來可以使用 pos & mask_ 取代 pos % capacity。
+// 4. main為benchmark：在1..N個生產者/消費者的情況下，比較原本deque+mutex的Queue以及RingQueue的吞吐量。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std::literals;
+
+constexpr std::size_t cache_line_size = 64;
+
+// 原本的 deque + mutex 版本 (與Simple_Thread_Pool.cpp相同)，作為benchmark的比較基準。
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(val);
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = dq_.front();
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+template<typename T>
+class RingQueue{
+    struct alignas(cache_line_size) Cell{
+        std::atomic<std::size_t> seq;
+        T data;
+    };
+    std::unique_ptr<Cell[]> buf_;
+    const std::size_t mask_;
+    alignas(cache_line_size) std::atomic<std::size_t> head_{0};  // 下一個要寫入的位置(生產者)
+    alignas(cache_line_size) std::atomic<std::size_t> tail_{0};  // 下一個要讀取的位置(消費者)
+    alignas(cache_line_size) std::atomic<int> sleepers{0};       // 正在cv上睡覺的消費者數量
+    std::atomic<bool> closed{false};
+    std::mutex m;                                                // 只有睡覺/叫醒的時候才會用到
+    std::condition_variable cv;
+
+    static constexpr int spin_limit = 64;
+
+public:
+    explicit RingQueue(std::size_t capacity = 1024)
+        : buf_(new Cell[capacity]), mask_(capacity - 1){
+        if(capacity < 2 || (capacity & (capacity - 1)) != 0){
+            throw std::invalid_argument("RingQueue capacity must be a power of two");
+        }
+        for(std::size_t i = 0; i < capacity; i++){
+            buf_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // 成功放入回傳true，佇列滿了回傳false。
+    bool TryEnqueue(T& val){
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        while(true){
+            Cell& cell = buf_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = (std::intptr_t)seq - (std::intptr_t)pos;
+            if(diff == 0){                  // 這一格是空的，試著搶下這個位置
+                if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    cell.data = std::move(val);
+                    cell.seq.store(pos + 1, std::memory_order_release);   // 發布給消費者
+                    return true;
+                }
+            }else if(diff < 0){             // 消費者還沒把上一輪的資料拿走 -> 滿了
+                return false;
+            }else{                          // 被別的生產者搶先了，重新讀取位置
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 成功取出回傳true，佇列是空的回傳false。
+    bool TryDequeue(T& value){
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        while(true){
+            Cell& cell = buf_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = (std::intptr_t)seq - (std::intptr_t)(pos + 1);
+            if(diff == 0){
+                if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    value = std::move(cell.data);
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);  // 讓出這一格給下一輪的生產者
+                    return true;
+                }
+            }else if(diff < 0){             // 生產者還沒寫入 -> 空的
+                return false;
+            }else{
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Enqueue(T val){
+        while(!TryEnqueue(val)){
+            std::this_thread::yield();      // 滿了：等消費者消化
+        }
+        // 與WaitandDequeue中的sleepers.fetch_add配對(Dekker式的StoreLoad)，
+        // 確保「生產者沒看到sleepers」和「消費者沒看到資料」不會同時發生(lost wakeup)。
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleepers.load(std::memory_order_relaxed) > 0){
+            { std::lock_guard<std::mutex> lk(m); }  // 確保消費者不是卡在「檢查完條件但還沒睡著」之間
+            cv.notify_one();
+        }
+    }
+
+    bool WaitandDequeue(T& value){
+        for(int i = 0; i < spin_limit; i++){          // 快速路徑：不碰mutex
+            if(TryDequeue(value)) return true;
+            if(closed.load(std::memory_order_acquire)) break;
+        }
+        std::unique_lock<std::mutex> uk(m);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got = false;
+        cv.wait(uk, [&]{
+            got = TryDequeue(value);
+            return got || closed.load();
+        });
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if(got) return true;
+        uk.unlock();
+        return TryDequeue(value);                     // Close以後仍然要把剩下的資料消化完
+    }
+
+    void Close(){
+        closed.store(true);
+        { std::lock_guard<std::mutex> lk(m); }
+        cv.notify_all();
+    }
+};
+
+template<typename Q>
+double bench(int producers, int consumers, std::size_t items_per_producer){
+    Q q;
+    std::atomic<std::uint64_t> total{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> cs;
+        for(int c = 0; c < consumers; c++){
+            cs.emplace_back([&]{
+                std::uint64_t local = 0, v;
+                while(q.WaitandDequeue(v)) local += v;
+                total += local;
+            });
+        }
+        {
+            std::vector<std::jthread> ps;
+            for(int p = 0; p < producers; p++){
+                ps.emplace_back([&]{
+                    for(std::size_t i = 1; i <= items_per_producer; i++) q.Enqueue(i);
+                });
+            }
+        }
+        q.Close();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::uint64_t expected = producers * (items_per_producer * (items_per_producer + 1) / 2);
+    if(total != expected){
+        std::cout << "checksum mismatch: " << total << " != " << expected << std::endl;
+    }
+    double sec = std::chrono::duration<double>(end - start).count();
+    return producers * items_per_producer / sec / 1e6;   // Mops/s
+}
+
+int main(){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+
+    // 功能測試：與Simple_Thread_Pool.cpp相同的用法。
+    RingQueue<int> Jobs(8);
+    std::vector<std::thread> workers;
+    std::atomic<int> sum{0};
+    for(int i = 0; i < thread_num; i++){
+        workers.push_back(std::thread{[&Jobs, &sum]{
+            int job;
+            while(Jobs.WaitandDequeue(job)) sum += job;
+        }});
+    }
+    for(int i = 1; i <= 100; i++) Jobs.Enqueue(i);
+    Jobs.Close();
+    for(auto& t: workers) t.join();
+    std::cout << "sum(1..100) = " << sum << std::endl;
+
+    // Benchmark
+    constexpr std::size_t items = 200000;
+    std::cout << "P/C\tdeque+mutex (Mops/s)\tring (Mops/s)" << std::endl;
+    for(int n = 1; ; n = std::min(n * 2, thread_num)){   // 1, 2, 4, ..., 最後一定跑到 N/N
+        double base = bench<Queue<std::uint64_t>>(n, n, items);
+        double ring = bench<RingQueue<std::uint64_t>>(n, n, items);
+        std::cout << n << "/" << n << "\t" << base << "\t\t\t" << ring << std::endl;
+        if(n >= thread_num) break;
+    }
+
+    return 0;
+}
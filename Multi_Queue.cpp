@@ -0,0 +1,394 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Simple_Thread_Pool.cpp中所有worker搶同一個Queue<T>的mutex；Lock_Free_Ring_Buffer_Queue.cpp的RingQueue
+//    雖然沒有mutex，但所有執行緒仍然在head_/tail_這兩個cache line上互相搶CAS。
+// 2. MultiQueue：放棄嚴格的FIFO，換取幾乎線性的擴展性(near-linear scaling)。
+//    a. 內部有 k × workers 個彼此獨立、各自有mutex的子佇列(shard)，每個shard對齊cache line。
+//    b. Enqueue：替任務加上時間戳記(label)，隨機挑一個shard放進去(try_lock失敗就換一個)。
+//    c. Dequeue：隨機挑兩個shard，比較它們最前面任務的label(top，不用拿鎖就可以讀)，
+//       從比較舊的那一個拿(power-of-two-choices)。抽到空的shard太多次才依序掃過所有shard，
+//       全部都是空的才算是空的。
+//    d. 睡覺/叫醒與RingQueue相同：消費者先自旋，再到condition_variable上睡覺，
+//       生產者只有在sleepers > 0時才拿mutex叫醒別人。
+//    API與Queue<T>相同(Enqueue / WaitandDequeue / Close)，可以直接放進Simple_Thread_Pool.cpp的worker迴圈。
+// 3. 排序品質(ordering quality)以平均rank error衡量：每次取出的元素，當下佇列中還有幾個比它更早放進去的元素。
+//    嚴格FIFO的佇列為0。
+// 4. main為benchmark：在1..N個生產者/消費者下比較Queue、RingQueue以及MultiQueue的吞吐量，以及三者的rank error。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std::literals;
+
+constexpr std::size_t cache_line_size = 64;
+
+// 原本的 deque + mutex 版本 (與Simple_Thread_Pool.cpp相同)，作為benchmark的比較基準。
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+// 與Lock_Free_Ring_Buffer_Queue.cpp相同。
+template<typename T>
+class RingQueue{
+    struct alignas(cache_line_size) Cell{
+        std::atomic<std::size_t> seq;
+        T data;
+    };
+    std::unique_ptr<Cell[]> buf_;
+    const std::size_t mask_;
+    alignas(cache_line_size) std::atomic<std::size_t> head_{0};
+    alignas(cache_line_size) std::atomic<std::size_t> tail_{0};
+    alignas(cache_line_size) std::atomic<int> sleepers{0};
+    std::atomic<bool> closed{false};
+    std::mutex m;
+    std::condition_variable cv;
+
+    static constexpr int spin_limit = 64;
+
+public:
+    explicit RingQueue(std::size_t capacity = 1024)
+        : buf_(new Cell[capacity]), mask_(capacity - 1){
+        if(capacity < 2 || (capacity & (capacity - 1)) != 0){
+            throw std::invalid_argument("RingQueue capacity must be a power of two");
+        }
+        for(std::size_t i = 0; i < capacity; i++){
+            buf_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool TryEnqueue(T& val){
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        while(true){
+            Cell& cell = buf_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = (std::intptr_t)seq - (std::intptr_t)pos;
+            if(diff == 0){
+                if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    cell.data = std::move(val);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(diff < 0){
+                return false;
+            }else{
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryDequeue(T& value){
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        while(true){
+            Cell& cell = buf_[pos & mask_];
+            std::size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = (std::intptr_t)seq - (std::intptr_t)(pos + 1);
+            if(diff == 0){
+                if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    value = std::move(cell.data);
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(diff < 0){
+                return false;
+            }else{
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Enqueue(T val){
+        while(!TryEnqueue(val)){
+            std::this_thread::yield();
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleepers.load(std::memory_order_relaxed) > 0){
+            { std::lock_guard<std::mutex> lk(m); }
+            cv.notify_one();
+        }
+    }
+
+    bool WaitandDequeue(T& value){
+        for(int i = 0; i < spin_limit; i++){
+            if(TryDequeue(value)) return true;
+            if(closed.load(std::memory_order_acquire)) break;
+        }
+        std::unique_lock<std::mutex> uk(m);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got = false;
+        cv.wait(uk, [&]{
+            got = TryDequeue(value);
+            return got || closed.load();
+        });
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if(got) return true;
+        uk.unlock();
+        return TryDequeue(value);
+    }
+
+    void Close(){
+        closed.store(true);
+        { std::lock_guard<std::mutex> lk(m); }
+        cv.notify_all();
+    }
+};
+
+template<typename T>
+class MultiQueue{
+    static constexpr std::uint64_t empty_label = UINT64_MAX;
+
+    struct Item{
+        T value;
+        std::uint64_t label;
+    };
+    struct alignas(cache_line_size) Shard{
+        std::mutex m;
+        std::deque<Item> dq_;
+        std::atomic<std::uint64_t> top{empty_label};   // 最前面任務的label，空的時候為empty_label
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+    const std::size_t n_;
+    alignas(cache_line_size) std::atomic<int> sleepers{0};
+    std::atomic<bool> closed{false};
+    std::mutex m;                                      // 只有睡覺/叫醒的時候才會用到
+    std::condition_variable cv;
+
+    static constexpr int spin_limit = 64;
+
+    static std::uint64_t now_label(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static std::uint64_t next_random(){                // 每條執行緒各自的xorshift64，不需要同步
+        thread_local std::uint64_t x = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        return x;
+    }
+
+    // 需持有s.m
+    static bool pop_locked(Shard& s, T& value){
+        if(s.dq_.empty()) return false;
+        value = std::move(s.dq_.front().value);
+        s.dq_.pop_front();
+        s.top.store(s.dq_.empty() ? empty_label : s.dq_.front().label, std::memory_order_relaxed);
+        return true;
+    }
+
+public:
+    explicit MultiQueue(std::size_t workers = std::thread::hardware_concurrency(), std::size_t k = 4)
+        : shards_(new Shard[std::max<std::size_t>(2, k * workers)]), n_(std::max<std::size_t>(2, k * workers)){}
+
+    void Enqueue(T val){
+        std::uint64_t label = now_label();
+        while(true){
+            Shard& s = shards_[next_random() % n_];
+            std::unique_lock<std::mutex> lk(s.m, std::try_to_lock);
+            if(!lk.owns_lock()) continue;             // 有人在用，換一個shard
+            s.dq_.push_back({std::move(val), label});
+            if(s.dq_.size() == 1) s.top.store(label, std::memory_order_relaxed);
+            break;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);   // 與WaitandDequeue中的sleepers.fetch_add配對
+        if(sleepers.load(std::memory_order_relaxed) > 0){
+            { std::lock_guard<std::mutex> lk(m); }
+            cv.notify_one();
+        }
+    }
+
+    bool TryDequeue(T& value){
+        for(std::size_t misses = 0; misses < n_; ){   // power-of-two-choices
+            std::size_t i = next_random() % n_, j = next_random() % n_;
+            std::uint64_t a = shards_[i].top.load(std::memory_order_relaxed);
+            std::uint64_t b = shards_[j].top.load(std::memory_order_relaxed);
+            if(a == empty_label && b == empty_label){
+                misses++;
+                continue;
+            }
+            Shard& s = shards_[a <= b ? i : j];
+            std::unique_lock<std::mutex> lk(s.m, std::try_to_lock);
+            if(!lk.owns_lock()) continue;             // 有人在用，重新抽兩個 (不算miss)
+            if(pop_locked(s, value)) return true;
+            misses++;
+        }
+        for(std::size_t i = 0; i < n_; i++){          // 運氣不好：依序掃過所有shard
+            Shard& s = shards_[i];
+            if(s.top.load(std::memory_order_relaxed) == empty_label) continue;
+            std::lock_guard<std::mutex> lk(s.m);
+            if(pop_locked(s, value)) return true;
+        }
+        return false;
+    }
+
+    bool WaitandDequeue(T& value){
+        for(int i = 0; i < spin_limit; i++){
+            if(TryDequeue(value)) return true;
+            if(closed.load(std::memory_order_acquire)) break;
+        }
+        std::unique_lock<std::mutex> uk(m);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got = false;
+        cv.wait(uk, [&]{
+            got = TryDequeue(value);
+            return got || closed.load();
+        });
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if(got) return true;
+        uk.unlock();
+        return TryDequeue(value);                     // Close以後仍然要把剩下的資料消化完
+    }
+
+    void Close(){
+        closed.store(true);
+        { std::lock_guard<std::mutex> lk(m); }
+        cv.notify_all();
+    }
+};
+
+template<typename Q>
+double bench(int producers, int consumers, std::size_t items_per_producer){
+    Q q;
+    std::atomic<std::uint64_t> total{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> cs;
+        for(int c = 0; c < consumers; c++){
+            cs.emplace_back([&]{
+                std::uint64_t local = 0, v;
+                while(q.WaitandDequeue(v)) local += v;
+                total += local;
+            });
+        }
+        {
+            std::vector<std::jthread> ps;
+            for(int p = 0; p < producers; p++){
+                ps.emplace_back([&]{
+                    for(std::size_t i = 1; i <= items_per_producer; i++) q.Enqueue(i);
+                });
+            }
+        }
+        q.Close();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::uint64_t expected = producers * (items_per_producer * (items_per_producer + 1) / 2);
+    if(total != expected){
+        std::cout << "checksum mismatch: " << total << " != " << expected << std::endl;
+    }
+    double sec = std::chrono::duration<double>(end - start).count();
+    return producers * items_per_producer / sec / 1e6;   // Mops/s
+}
+
+// 依序放入0..items-1，再由consumers條執行緒同時取出，依照取出的先後順序(ticket)回放：
+// 每次取出v時，rank error = 仍在佇列中且比v小(比v早放入)的元素個數，以Fenwick tree計算。
+template<typename Q>
+double rank_error(Q& q, int consumers, std::size_t items){
+    for(std::size_t i = 0; i < items; i++) q.Enqueue(i);
+    q.Close();
+    std::vector<std::uint64_t> order(items);
+    std::atomic<std::size_t> ticket{0};
+    {
+        std::vector<std::jthread> cs;
+        for(int c = 0; c < consumers; c++){
+            cs.emplace_back([&]{
+                std::uint64_t v;
+                while(q.WaitandDequeue(v)) order[ticket.fetch_add(1)] = v;
+            });
+        }
+    }
+    std::vector<long long> tree(items + 1, 0);
+    auto add = [&](std::size_t i, long long d){ for(i++; i <= items; i += i & (~i + 1)) tree[i] += d; };
+    auto prefix = [&](std::size_t i){ long long s = 0; for(; i > 0; i -= i & (~i + 1)) s += tree[i]; return s; };   // [0, i)
+    for(std::size_t i = 0; i < items; i++) add(i, 1);
+    long long sum = 0;
+    for(auto v: order){
+        sum += prefix(v);
+        add(v, -1);
+    }
+    return (double)sum / items;
+}
+
+struct Event{
+    int from;
+    int to;
+};
+
+int main(){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+
+    // 功能測試：與Simple_Thread_Pool.cpp相同的worker迴圈。
+    {
+        MultiQueue<Event> Jobs(thread_num);
+        std::vector<std::thread> workers;
+        std::atomic<int> sum{0};
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[&Jobs, &sum]{
+                Event event;
+                while(Jobs.WaitandDequeue(event)){
+                    sum += event.to - event.from;
+                }
+            }});
+        }
+        for(int i = 0; i < 100; i++) Jobs.Enqueue({i * 10, i * 10 + 10});
+        Jobs.Close();
+        for(auto& t: workers) t.join();
+        std::cout << "sum of range lengths = " << sum << " (expected 1000)" << std::endl;
+    }
+
+    // Benchmark
+    constexpr std::size_t items = 200000;
+    std::cout << "P/C\tdeque+mutex (Mops/s)\tring (Mops/s)\tmulti-queue (Mops/s)" << std::endl;
+    for(int n = 1; ; n = std::min(n * 2, thread_num)){   // 1, 2, 4, ..., 最後一定跑到 N/N
+        double base = bench<Queue<std::uint64_t>>(n, n, items);
+        double ring = bench<RingQueue<std::uint64_t>>(n, n, items);
+        double multi = bench<MultiQueue<std::uint64_t>>(n, n, items);
+        std::cout << n << "/" << n << "\t" << base << "\t\t\t" << ring << "\t\t" << multi << std::endl;
+        if(n >= thread_num) break;
+    }
+
+    constexpr std::size_t rank_items = 1 << 17;
+    Queue<std::uint64_t> q;
+    RingQueue<std::uint64_t> ring(rank_items);
+    MultiQueue<std::uint64_t> multi(thread_num);
+    std::cout << "average rank error (" << thread_num << " consumers):" << std::endl;
+    std::cout << "  deque+mutex: " << rank_error(q, thread_num, rank_items) << std::endl;
+    std::cout << "  ring:        " << rank_error(ring, thread_num, rank_items) << std::endl;
+    std::cout << "  multi-queue: " << rank_error(multi, thread_num, rank_items) << std::endl;
+
+    return 0;
+}
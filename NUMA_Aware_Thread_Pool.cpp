@@ -0,0 +1,313 @@
+// 編譯參數： -std=c++20 -O2 (Linux only, 需要/sys/devices/system以及pthread_setaffinity_np)
+// 1. Simple_Thread_Pool.cpp開了hardware_concurrency()條沒有固定核心(unpinned)的std::thread，
+//    作業系統可以任意搬移它們，而它們要處理的資料(排序用的vec、Vector_Map_Reduce.cpp中的values)
+//    可能放在遠端(remote)的NUMA node上，每一次存取都要跨過interconnect，頻寬低、延遲高。
+// 2. NumaThreadPool：
+//    a. 從/sys/devices/system/node/node*/cpulist以及/sys/devices/system/cpu/cpu*/topology讀取
+//       NUMA node、實體核心(core)以及hyperthread的對應關係。
+//    b. 依照PinPolicy決定開幾條worker以及固定(pin)在哪個CPU上：
+//       PerCore         -> 每個實體核心一條(只用每個核心的第一個hyperthread)
+//       PerHyperThread  -> 每個邏輯CPU一條
+//    c. 每個NUMA node有自己的任務佇列，post(node, f)把任務放到指定node的佇列，
+//       worker先拿自己node的任務，只有在自己node的佇列空了才去別的node偷(cross-node steal)。
+//    d. set_cross_node_steal(false)關閉跨node偷任務(沒有worker的node除外，否則它的任務永遠不會被執行)，
+//       任務一定在post指定的node上執行。
+// 3. Linux預設使用first-touch的記憶體配置：第一次寫入某一頁(page)的執行緒在哪個node，該頁就配置在哪個node。
+//    因此資料要由「之後會使用它的node」上的worker來初始化。
+// 4. main為benchmark：每個node先以first-touch初始化自己的那一段資料，
+//    再分別由本地(local)以及遠端(remote) node的worker對它做Max() (memory-bound)，比較兩者的頻寬。
+//    量測時關閉跨node偷任務：否則資料所在node閒置的worker會把「遠端」的任務偷回去，量到的其實是本地存取。
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <latch>
+#include <chrono>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <filesystem>
+#include <cctype>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std::literals;
+
+// "0-3,8-11" -> {0,1,2,3,8,9,10,11}
+std::vector<int> parse_cpulist(const std::string& list){
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while(std::getline(ss, range, ',')){
+        if(range.empty() || range == "\n") continue;
+        auto dash = range.find('-');
+        int lo = std::stoi(range.substr(0, dash));
+        int hi = (dash == std::string::npos) ? lo : std::stoi(range.substr(dash + 1));
+        for(int c = lo; c <= hi; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+std::string read_line(const std::filesystem::path& p){
+    std::ifstream in(p);
+    std::string s;
+    std::getline(in, s);
+    return s;
+}
+
+struct Topology{
+    struct Cpu{
+        int id;
+        int node;
+        int core;           // 同一個實體核心上的hyperthread有相同的(package, core_id)
+    };
+    std::vector<Cpu> cpus;
+    int nodes = 1;
+
+    static Topology discover(){
+        Topology topo;
+        std::map<int, int> node_of;
+        const std::filesystem::path node_root{"/sys/devices/system/node"};
+        std::error_code ec;
+        int max_node = -1;
+        for(auto& entry: std::filesystem::directory_iterator(node_root, ec)){
+            std::string name = entry.path().filename();
+            if(name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(name[4])) continue;
+            int node = std::stoi(name.substr(4));
+            max_node = std::max(max_node, node);
+            for(int cpu: parse_cpulist(read_line(entry.path() / "cpulist"))) node_of[cpu] = node;
+        }
+        topo.nodes = max_node + 1 > 0 ? max_node + 1 : 1;
+
+        std::map<std::pair<int, int>, int> core_ids;   // (package, core_id) -> 連續的core編號
+        std::vector<int> online = parse_cpulist(read_line("/sys/devices/system/cpu/online"));
+        if(online.empty()){
+            for(unsigned c = 0; c < std::thread::hardware_concurrency(); c++) online.push_back(c);
+        }
+        for(int cpu: online){
+            std::filesystem::path t = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology";
+            std::string pkg = read_line(t / "physical_package_id");
+            std::string core = read_line(t / "core_id");
+            auto key = std::make_pair(pkg.empty() ? 0 : std::stoi(pkg), core.empty() ? cpu : std::stoi(core));
+            auto it = core_ids.try_emplace(key, (int)core_ids.size()).first;
+            topo.cpus.push_back({cpu, node_of.count(cpu) ? node_of[cpu] : 0, it->second});
+        }
+        return topo;
+    }
+};
+
+enum class PinPolicy{ None, PerCore, PerHyperThread };
+
+bool pin_to_cpu(int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+class NumaThreadPool{
+    struct alignas(64) NodeQueue{
+        std::deque<std::function<void()>> dq_;
+        std::mutex m;
+        std::atomic<std::size_t> pending{0};          // 這個node還沒被拿走的任務數
+    };
+    std::vector<std::unique_ptr<NodeQueue>> queues_;   // 每個NUMA node一個
+    std::vector<std::thread> workers;
+    std::vector<int> workers_per_node_;
+    std::mutex m;                                      // 只用在睡覺/叫醒
+    std::condition_variable cv;
+    std::atomic<std::size_t> pending{0};               // 所有node還沒被拿走的任務數
+    std::atomic<bool> closed{false};
+    std::atomic<bool> steal_enabled{true};
+    std::atomic<std::size_t> steals{0};
+
+    // node上的worker可以從victim的佇列拿任務嗎？
+    bool may_take(int node, int victim) const {
+        return victim == node || steal_enabled.load(std::memory_order_relaxed) || workers_per_node_[victim] == 0;
+    }
+
+    bool has_work(int node) const {
+        if(steal_enabled.load(std::memory_order_relaxed)) return pending.load() > 0;
+        for(int v = 0; v < (int)queues_.size(); v++){
+            if(may_take(node, v) && queues_[v]->pending.load() > 0) return true;
+        }
+        return false;
+    }
+
+    bool try_pop(int node, std::function<void()>& task){
+        NodeQueue& q = *queues_[node];
+        std::lock_guard<std::mutex> lk(q.m);
+        if(q.dq_.empty()) return false;
+        task = std::move(q.dq_.front());
+        q.dq_.pop_front();
+        q.pending.fetch_sub(1, std::memory_order_relaxed);
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool next_task(int node, std::function<void()>& task){
+        if(try_pop(node, task)) return true;                   // 先拿本地node的任務
+        int n = queues_.size();
+        for(int d = 1; d < n; d++){                            // 本地空了才跨node偷
+            if(may_take(node, (node + d) % n) && try_pop((node + d) % n, task)){
+                steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(int node){
+        std::function<void()> task;
+        while(true){
+            if(next_task(node, task)){
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> uk(m);
+            cv.wait(uk, [this, node]{ return has_work(node) || closed.load(); });
+            if(!has_work(node) && closed.load()) return;
+        }
+    }
+
+public:
+    NumaThreadPool(const Topology& topo, PinPolicy policy)
+        : workers_per_node_(topo.nodes, 0){
+        for(int n = 0; n < topo.nodes; n++) queues_.push_back(std::make_unique<NodeQueue>());
+        std::set<int> used_cores;
+        std::vector<Topology::Cpu> selected;
+        for(const auto& cpu: topo.cpus){
+            if(policy == PinPolicy::PerCore && !used_cores.insert(cpu.core).second) continue;
+            workers_per_node_[cpu.node]++;
+            selected.push_back(cpu);
+        }
+        for(const auto& cpu: selected){                    // workers_per_node_填好以後才啟動worker (may_take會讀它)
+            workers.push_back(std::thread{[this, cpu, policy]{
+                if(policy != PinPolicy::None) pin_to_cpu(cpu.id);
+                worker_loop(cpu.node);
+            }});
+        }
+    }
+    ~NumaThreadPool(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            closed.store(true);
+        }
+        cv.notify_all();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+
+    int nodes() const { return queues_.size(); }
+    int workers_on(int node) const { return workers_per_node_[node]; }
+    std::size_t steal_count() const { return steals.load(); }
+
+    // 開啟/關閉跨node偷任務 (benchmark量測遠端存取時關閉)
+    void set_cross_node_steal(bool enabled){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            steal_enabled.store(enabled);
+        }
+        cv.notify_all();                                   // 重新開啟時，其他node的worker可能有任務可以偷
+    }
+
+    template<typename F>
+    void post(int node, F&& f){
+        NodeQueue& q = *queues_[node];
+        {
+            std::lock_guard<std::mutex> lk(m);             // 先計數再放進佇列：pop之後的fetch_sub不會減到0以下
+            q.pending.fetch_add(1);
+            pending.fetch_add(1);
+        }
+        {
+            std::lock_guard<std::mutex> lk(q.m);
+            q.dq_.push_back(std::forward<F>(f));
+        }
+        if(steal_enabled.load()) cv.notify_one();          // 任何一條worker都可以執行
+        else cv.notify_all();                              // 只有這個node的worker可以執行，notify_one可能叫醒別的node的worker
+    }
+};
+
+// 與Vector_Map_Reduce.cpp的Max()相同，只是每一段交給指定node上的worker執行。
+unsigned int Max(NumaThreadPool& pool, const unsigned int* data, std::size_t size, int node){
+    int parts = std::max(1, pool.workers_on(node));
+    std::size_t sizeofrange = (size + parts - 1) / parts;
+    std::vector<unsigned int> results(parts, 0);
+    std::latch done(parts);
+    for(int i = 0; i < parts; i++){
+        pool.post(node, [=, &results, &done]{
+            std::size_t start = std::min(size, i * sizeofrange);
+            std::size_t end = std::min(size, (i + 1) * sizeofrange);
+            unsigned int r = 0;
+            for(std::size_t j = start; j < end; j++){
+                if(data[j] > r) r = data[j];
+            }
+            results[i] = r;
+            done.count_down();
+        });
+    }
+    done.wait();
+    return *std::max_element(results.begin(), results.end());
+}
+
+int main(int argc, char* argv[]){
+    Topology topo = Topology::discover();
+    std::cout << "NUMA nodes: " << topo.nodes << ", CPUs: " << topo.cpus.size() << std::endl;
+    for(const auto& c: topo.cpus){
+        std::cout << "  cpu " << c.id << " -> node " << c.node << ", core " << c.core << std::endl;
+    }
+
+    NumaThreadPool pool(topo, PinPolicy::PerCore);
+    int nodes = pool.nodes();
+    std::size_t per_node = argc > 1 ? std::stoull(argv[1]) : (64u << 20) / nodes;   // 預設共64M個unsigned int (256MB)
+
+    // first-touch：每個node的資料由該node上的worker配置並初始化。
+    pool.set_cross_node_steal(false);                   // first-touch與量測的任務都一定在post的node上執行
+    std::vector<std::unique_ptr<unsigned int[]>> chunks(nodes);
+    {
+        std::latch done(nodes);
+        for(int n = 0; n < nodes; n++){
+            pool.post(n, [&chunks, &done, n, per_node]{
+                chunks[n].reset(new unsigned int[per_node]);   // 尚未寫入，實體頁面還沒配置
+                unsigned int x = 2463534242u + n;
+                for(std::size_t i = 0; i < per_node; i++){    // xorshift填入亂數 (first touch)
+                    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+                    chunks[n][i] = x;
+                }
+                done.count_down();
+            });
+        }
+        done.wait();
+    }
+
+    auto measure = [&](int data_node, int run_node){
+        auto start = std::chrono::steady_clock::now();
+        unsigned int m = Max(pool, chunks[data_node].get(), per_node, run_node);
+        auto end = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(end - start).count();
+        std::cout << "  data on node " << data_node << ", run on node " << run_node
+                  << ": max = " << m << ", " << per_node * sizeof(unsigned int) / sec / 1e9 << " GB/s" << std::endl;
+    };
+
+    std::cout << "local:" << std::endl;
+    for(int n = 0; n < nodes; n++) measure(n, n);
+    std::cout << "remote:" << std::endl;
+    if(nodes == 1){
+        std::cout << "  (only one NUMA node on this machine)" << std::endl;
+    }
+    for(int n = 0; n < nodes && nodes > 1; n++) measure(n, (n + 1) % nodes);
+    pool.set_cross_node_steal(true);
+    std::cout << "cross-node steals: " << pool.steal_count() << std::endl;
+
+    return 0;
+}
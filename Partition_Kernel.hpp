@@ -0,0 +1,136 @@
+// int的分類kernel (-std=c++17以上)
+// 1. quick_sort的分類迴圈 if(arr[j] < pivot) std::swap(...) 有分支，亂數資料大約每兩個元素就預測錯一次。
+// 2. partition::kernel(first, last, pivot)：把[first, last)中 < pivot 的元素放到前面，回傳個數。
+//    執行時依照CPU選擇：
+//    a. AVX-512：一次比較16個int，以compress store把 < pivot 的擠到左邊、其他的擠到右邊。
+//    b. AVX2：一次比較8個int，以查表的permutation取代compress store。
+//    c. 其他CPU：原本的scalar迴圈。
+// 3. 向量版本(in-place)：先把頭尾各一個vector的元素存在register中空出位置，之後每次從「空位比較少」的那一邊讀一個vector，
+//    比較以後 < pivot 的元素擠到左邊的空位、其他的擠到右邊的空位，空位的總數永遠是兩個vector，讀寫不會互相覆蓋；
+//    最後剩下不到一個vector的元素以及一開始存起來的兩個vector逐一放回中間的空位。
+// 4. kernel以__attribute__((target(...)))個別編譯，不需要-mavx2等編譯參數。
+#pragma once
+
+#include <cstring>
+#include <utility>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace partition{
+
+using Kernel = int (*)(int* first, int* last, int pivot);
+
+inline int scalar(int* first, int* last, int pivot){
+    int* i = first;
+    for(int* j = first; j < last; j++){
+        if(*j < pivot){
+            std::swap(*i, *j);
+            i++;
+        }
+    }
+    return i - first;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 把最後剩下的元素(rest)逐一放回[wl, wr)
+inline int* put_rest(const int* rest, int n, int* wl, int* wr, int pivot){
+    for(int k = 0; k < n; k++){
+        if(rest[k] < pivot) *wl++ = rest[k];
+        else *--wr = rest[k];
+    }
+    return wl;
+}
+
+// AVX2沒有compress store：以查表的permutation把 < pivot 的lane排到前面、其他的排到後面，
+// 同一個vector整個寫到左邊的空位(前段有效)以及右邊的空位(後段有效)。
+struct PermutationTable{
+    alignas(32) int idx[256][8];
+};
+inline const PermutationTable permutation_table = []{
+    PermutationTable t{};
+    for(int m = 0; m < 256; m++){
+        int p = 0;
+        for(int lane = 0; lane < 8; lane++) if(m >> lane & 1) t.idx[m][p++] = lane;
+        for(int lane = 0; lane < 8; lane++) if(!(m >> lane & 1)) t.idx[m][p++] = lane;
+    }
+    return t;
+}();
+
+__attribute__((target("avx2")))
+inline int avx2(int* first, int* last, int pivot){
+    constexpr int V = 8;
+    if(last - first < 2 * V) return scalar(first, last, pivot);
+    const __m256i pv = _mm256_set1_epi32(pivot);
+    __m256i vl = _mm256_loadu_si256((const __m256i*)first);
+    __m256i vr = _mm256_loadu_si256((const __m256i*)(last - V));
+    int *rl = first + V, *rr = last - V, *wl = first, *wr = last;
+    while(rr - rl >= V){
+        __m256i v;
+        if(rl - wl <= wr - rr){
+            v = _mm256_loadu_si256((const __m256i*)rl);
+            rl += V;
+        }else{
+            rr -= V;
+            v = _mm256_loadu_si256((const __m256i*)rr);
+        }
+        int m = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pv, v)));
+        int nl = __builtin_popcount(m);
+        __m256i p = _mm256_permutevar8x32_epi32(v, _mm256_load_si256((const __m256i*)permutation_table.idx[m]));
+        _mm256_storeu_si256((__m256i*)wl, p);
+        _mm256_storeu_si256((__m256i*)(wr - V), p);
+        wl += nl;
+        wr -= V - nl;
+    }
+    int buf[3 * V];
+    int r = rr - rl;
+    std::memcpy(buf, rl, r * sizeof(int));
+    _mm256_storeu_si256((__m256i*)(buf + r), vl);
+    _mm256_storeu_si256((__m256i*)(buf + r + V), vr);
+    return put_rest(buf, r + 2 * V, wl, wr, pivot) - first;
+}
+
+__attribute__((target("avx512f")))
+inline int avx512(int* first, int* last, int pivot){
+    constexpr int V = 16;
+    if(last - first < 2 * V) return scalar(first, last, pivot);
+    const __m512i pv = _mm512_set1_epi32(pivot);
+    __m512i vl = _mm512_loadu_si512(first);
+    __m512i vr = _mm512_loadu_si512(last - V);
+    int *rl = first + V, *rr = last - V, *wl = first, *wr = last;
+    while(rr - rl >= V){
+        __m512i v;
+        if(rl - wl <= wr - rr){
+            v = _mm512_loadu_si512(rl);
+            rl += V;
+        }else{
+            rr -= V;
+            v = _mm512_loadu_si512(rr);
+        }
+        __mmask16 m = _mm512_cmplt_epi32_mask(v, pv);
+        int nl = __builtin_popcount(m);
+        _mm512_mask_compressstoreu_epi32(wl, m, v);
+        wl += nl;
+        wr -= V - nl;
+        _mm512_mask_compressstoreu_epi32(wr, (__mmask16)~m, v);
+    }
+    int buf[3 * V];
+    int r = rr - rl;
+    std::memcpy(buf, rl, r * sizeof(int));
+    _mm512_storeu_si512(buf + r, vl);
+    _mm512_storeu_si512(buf + r + V, vr);
+    return put_rest(buf, r + 2 * V, wl, wr, pivot) - first;
+}
+#endif
+
+// 依照執行時的CPU選擇kernel
+inline Kernel select_kernel(){
+#if defined(__x86_64__) || defined(__i386__)
+    if(__builtin_cpu_supports("avx512f")) return avx512;
+    if(__builtin_cpu_supports("avx2")) return avx2;
+#endif
+    return scalar;
+}
+inline const Kernel kernel = select_kernel();
+
+}  // namespace partition
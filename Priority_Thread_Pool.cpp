@@ -0,0 +1,243 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Queue<T>內部是FIFO的std::deque，對延遲敏感(latency-sensitive)的請求只能排在大量背景工作
+//    (bulk background work)的後面等。
+// 2. PriorityQueue<T>：
+//    a. 分成多個優先權等級(priority class)，0為最高，worker永遠先從高的等級拿任務。
+//    b. 同一個等級內可以指定deadline，以earliest-deadline-first (EDF)的順序取出；
+//       沒有指定deadline的任務排在有deadline的任務後面，彼此之間維持FIFO (以序號seq決定)。
+//    c. 為了避免低優先權的任務永遠拿不到(starvation)，使用aging：每次取出任務前，
+//       檢查每個等級中等待最久的任務，若已經等待超過aging_limit，就把它提升到上一個等級。
+//       每個等級的任務放在依照進入順序排列的std::list (FIFO)中，另外以std::set保存EDF的順序，
+//       因此沒有deadline的任務也會依照等待時間被提升。提升時給它一個有效的deadline (now + aging_limit)，
+//       到了等級0也會在源源不絕的deadline任務之間輪到，不會被餓死。
+//       等級0已經沒有上一個等級：等待太久的任務留在原地，同樣把deadline改為min(deadline, now + aging_limit)，
+//       直接送進等級0而且沒有deadline(或deadline很遠)的任務也不會被餓死。
+// 3. main為benchmark：在低優先權任務塞滿(saturating)所有worker的情況下，量測高優先權任務從
+//    送出到開始執行之間的延遲(p50/p99)，並和單一FIFO佇列比較。
+#include <iostream>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <list>
+#include <set>
+#include <string>
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+template<typename T>
+class PriorityQueue{
+    struct Item{
+        T value;
+        Clock::time_point deadline;     // 沒有deadline時為time_point::max()
+        Clock::time_point enqueued;
+        std::uint64_t seq;
+    };
+    using ItemIt = typename std::list<Item>::iterator;
+    struct Earlier{                      // EDF：deadline早的在前，相同時依照序號(FIFO)
+        bool operator()(const ItemIt& a, const ItemIt& b) const{
+            if(a->deadline != b->deadline) return a->deadline < b->deadline;
+            return a->seq < b->seq;
+        }
+    };
+    struct Class{
+        std::list<Item> fifo;            // 依照進入這個等級的時間排列，front()等待最久
+        std::set<ItemIt, Earlier> edf;   // 同樣的任務，依照取出的順序排列
+    };
+
+    std::vector<Class> classes_;
+    Clock::duration aging_limit_;
+    std::uint64_t seq_ = 0;
+    std::size_t size_ = 0;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+
+    void push_locked(int cls, Item item){
+        auto& c = classes_[cls];
+        c.fifo.push_back(std::move(item));
+        c.edf.insert(std::prev(c.fifo.end()));
+    }
+
+    Item pop_locked(int cls){
+        auto& c = classes_[cls];
+        ItemIt it = *c.edf.begin();
+        c.edf.erase(c.edf.begin());
+        Item item = std::move(*it);
+        c.fifo.erase(it);
+        return item;
+    }
+
+    // 等待超過aging_limit的任務(每個等級的fifo前段)提升一個等級，list節點直接搬過去(splice)，不需要複製。
+    // 提升時deadline改為min(deadline, now + aging_limit)：在新的等級中也不會因為沒有deadline而一直排在最後，
+    // 最多再等aging_limit就會排在新進來的deadline任務前面 (包括提升到等級0的任務)。
+    // 等級0的任務原地aging：改完deadline以後重新放進edf，並且搬到fifo的最後面重新計時。
+    void age_locked(Clock::time_point now){
+        for(std::size_t cls = 0; cls < classes_.size(); cls++){
+            auto& from = classes_[cls];
+            auto& to = classes_[cls == 0 ? 0 : cls - 1];
+            while(!from.fifo.empty() && now - from.fifo.front().enqueued > aging_limit_){
+                ItemIt it = from.fifo.begin();
+                from.edf.erase(it);
+                it->enqueued = now;              // 在新的等級重新開始計時
+                it->deadline = std::min(it->deadline, now + aging_limit_);
+                to.fifo.splice(to.fifo.end(), from.fifo, it);
+                to.edf.insert(it);
+            }
+        }
+    }
+
+public:
+    explicit PriorityQueue(int levels = 3, Clock::duration aging_limit = 50ms)
+        : classes_(levels), aging_limit_(aging_limit){}
+
+    int levels() const { return classes_.size(); }
+
+    void Enqueue(T val, int priority, Clock::time_point deadline = Clock::time_point::max()){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            priority = std::clamp(priority, 0, (int)classes_.size() - 1);
+            push_locked(priority, Item{std::move(val), deadline, Clock::now(), seq_++});
+            size_++;
+        }
+        cv.notify_one();
+    }
+
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (size_ != 0||closed.load());});
+        if(size_ == 0) return false;
+        age_locked(Clock::now());
+        for(std::size_t cls = 0; cls < classes_.size(); cls++){
+            if(!classes_[cls].fifo.empty()){
+                value = std::move(pop_locked(cls).value);
+                size_--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+class PriorityThreadPool{
+    PriorityQueue<std::function<void()>> Jobs;
+    std::vector<std::thread> workers;
+public:
+    explicit PriorityThreadPool(int thread_num, int levels = 3, Clock::duration aging_limit = 50ms)
+        : Jobs(levels, aging_limit){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this]{
+                std::function<void()> task;
+                while(Jobs.WaitandDequeue(task)){
+                    task();
+                }
+            }});
+        }
+    }
+    ~PriorityThreadPool(){
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+
+    template<typename F>
+    void post(int priority, F&& f){ Jobs.Enqueue(std::forward<F>(f), priority); }
+
+    template<typename F>
+    void post(int priority, Clock::time_point deadline, F&& f){ Jobs.Enqueue(std::forward<F>(f), priority, deadline); }
+};
+
+void busy_for(Clock::duration d){
+    auto end = Clock::now() + d;
+    while(Clock::now() < end){}
+}
+
+// 先送出一批低優先權的任務，讓每個worker都有約200ms的積壓工作(saturating load)，
+// 之後持續送出低優先權任務，每隔low_per_high個插入一個高優先權任務，記錄它等了多久才開始執行。
+// levels = 1 時所有任務都在同一個等級 => 等同於原本的FIFO佇列。
+void bench(const char* name, int thread_num, int levels){
+    constexpr int high_tasks = 200, low_per_high = 20;
+    std::vector<long long> latencies(high_tasks);
+    std::atomic<int> low_done{0};
+    {
+        PriorityThreadPool pool(thread_num, levels, 20ms);
+        int low = levels - 1;
+        auto low_task = [&low_done]{
+            busy_for(200us);
+            low_done++;
+        };
+        for(int i = 0; i < 1000 * thread_num; i++){
+            pool.post(low, low_task);
+        }
+        for(int i = 0; i < high_tasks; i++){
+            for(int j = 0; j < low_per_high; j++){
+                pool.post(low, low_task);
+            }
+            auto sent = Clock::now();
+            pool.post(0, sent + 1ms, [&latencies, i, sent]{
+                latencies[i] = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sent).count();
+            });
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << "\thigh priority latency p50: " << latencies[high_tasks / 2] << " us"
+              << "\tp99: " << latencies[high_tasks * 99 / 100] << " us"
+              << "\t(low priority tasks done: " << low_done << ")" << std::endl;
+}
+
+int main(){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+
+    // EDF + aging的簡單示範
+    {
+        PriorityQueue<int> q(2, 5ms);
+        q.Enqueue(4, 1);
+        std::this_thread::sleep_for(10ms);  // 只有低優先權的任務等超過aging_limit，會被提升
+        auto now = Clock::now();
+        q.Enqueue(1, 0, now + 30ms);
+        q.Enqueue(2, 0, now + 10ms);
+        q.Enqueue(3, 0);
+        q.Close();
+        int v;
+        std::cout << "dequeue order:";
+        while(q.WaitandDequeue(v)) std::cout << " " << v;
+        std::cout << std::endl;
+    }
+
+    // 沒有deadline(或deadline很遠)的任務在源源不絕的等級0 deadline任務之下仍然會被執行：
+    // 低優先權的任務靠提升，直接送進等級0的任務靠原地aging。
+    auto starvation = [](const char* name, int priority, Clock::time_point deadline){
+        PriorityQueue<int> q(2, 5ms);
+        q.Enqueue(-1, priority, deadline);
+        int rounds = 0, v = 0;
+        for(; rounds < 100000; rounds++){
+            q.Enqueue(rounds, 0, Clock::now() + 1ms);    // 每一輪都有新的等級0任務，deadline都很近
+            q.WaitandDequeue(v);
+            if(v == -1) break;
+            busy_for(50us);
+        }
+        std::cout << name << " under a class-0 deadline stream: "
+                  << (v == -1 ? "ran after " + std::to_string(rounds) + " rounds" : "starved") << std::endl;
+    };
+    starvation("class-1 task, no deadline", 1, Clock::time_point::max());
+    starvation("class-0 task, no deadline", 0, Clock::time_point::max());
+    starvation("class-0 task, deadline in 10s", 0, Clock::now() + 10s);
+
+    bench("FIFO", thread_num, 1);
+    bench("priority", thread_num, 3);
+
+    return 0;
+}
@@ -5,6 +5,64 @@
 // 4. 每個執行緒要盡量執行到沒有事情做為止，避免一直切換造成額外的負擔(overhead)。
 //    每次要開啟一個新的執行緒成本是很高的(需要1000多行指令)，這也是使用thread pool
 //    的一個最重要原因。
+//    SortPool只開thread_num-1條worker，呼叫排序的執行緒自己是最後一條：等待時一起從Jobs拿工作來做，
+//    沒有工作時和worker一樣睡在Jobs上，不再以while(ct!=0) yield()空轉。
+//    完成與否不再由一個所有執行緒共用的std::atomic<int> ct記錄：每條執行緒有自己的計數器(放出去幾個Event、做完幾個)，
+//    只有自己會寫入；等待的一方先加總做完的個數，再加總放出去的個數，兩者相等時才是全部做完。
+//    worker沒有工作、準備睡著時(很少發生)才檢查一次，全部做完時叫醒呼叫端。
+// 5. 第一次呼叫quick_sort時，整個[0, n)的分類(classification)都由一條執行緒完成，其他worker要等它做完才拿得到工作，
+//    這個O(n)的序列(serial)步驟依照Amdahl's law限制了整體的加速。
+//    區間長度超過parallel_partition_min而且pool中有閒置的worker時改用parallel_partition()：
+//    a. 把區間切成數個連續的block，每條執行緒各自分類自己的block (< pivot的放前面)。
+//    b. 加總(prefix sum)每個block中 < pivot 的個數得到分界點mid。
+//    c. 左半邊[.., mid)中 >= pivot 的區段與右半邊[mid, ..)中 < pivot 的區段總長度一定相同，
+//       平均分給每條執行緒互相交換(swap_ranges)。
+//    d. a、c兩個步驟不另外開執行緒，而是把BlockJob放進同一個pool的Jobs，由閒置的worker來幫忙；
+//       block由先搶到的人做，沒有人來幫忙時呼叫端自己全部做完，所以block數最多只有「閒置的worker數 + 1」，
+//       實際上只有一開始的幾層會切開。
+//       呼叫端做完自己的block以後睡在BlockJob的condition variable上，由最後一個做完block的thread叫醒，不空轉。
+// 6. 原本永遠以arr[start]當pivot，反序(vec[i] = num - i)或已經排好的輸入會退化成O(n^2)，遞迴深度也會變成n。
+//    參考pdqsort：
+//    a. pivot取頭、中、尾三個元素的中位數(median-of-3)，長度夠長時取9個元素的中位數的中位數(ninther)。
+//    b. 分類之前先檢查整段是否已經排好(直接結束)或完全反序(反轉後結束)，亂數資料在前幾個元素就會停止檢查。
+//    c. 每個Event帶著這個區間還能容忍幾次「分得太不平均」的分類(bad_allowed，初始值為log2(n))，
+//       每次不平均時把兩邊幾個元素互換以破壞輸入的規律，額度用完以後改用heapsort，單執行緒以及pool的版本都保證最差O(n log n)。
+//    d. 前一個元素(上一次分類的pivot)與這次的pivot相同時，區間內沒有比pivot小的元素：
+//       把等於pivot的元素都分到左邊，左邊就不用再排了，重複值很多的輸入因此不會退化。
+//    e. 長度在network::small_sort_max以下的區間直接用network::small_sort (Sorting_Network.hpp)：
+//       16個以下用編譯時期產生的sorting network，更長的再以insertion sort補上。
+// 7. 遞迴的quick_sort一開始只有一兩個區間可以做，平行度要切好幾層以後才慢慢出現。
+//    sample_sort()與sort_with_pool()的用法相同，一開始就切出足夠多的獨立工作：
+//    a. 隨機抽樣、排序樣本，選出buckets-1個splitter (每條執行緒samplesort_buckets_per_thread個bucket)。
+//    b. 每條執行緒把自己那一段的元素分到bucket，並累計自己的histogram。
+//    c. 以prefix sum算出每條執行緒在每個bucket中的寫入位置，平行地搬(scatter)到暫存的vector再換回來。
+//    d. 每個bucket都是一個Event，一次全部放進pool，由quick_sort各自排序。
+//    b、c兩個平行的步驟也以run_on_pool在同一個SortPool上執行，整個sample_sort只開一次執行緒。
+// 8. 排序的對象大多是int/unsigned，比較排序(comparison sort)每個元素要比較O(log n)次。
+//    radix_sort()是平行的LSD radix sort，每一輪處理key的8個bit (一個digit)：
+//    a. 每條執行緒計算自己那一段的digit histogram，所有元素都落在同一個digit時整輪跳過。
+//    b. prefix sum算出每條執行緒、每個digit的全域寫入位置。
+//    c. scatter時先寫進每個digit一個cache line大小的write-combining buffer，滿了才整條寫到目的地，
+//       避免256個寫入位置同時在cache以及TLB中互相擠掉。
+//    每一輪的a、c兩個平行步驟都以run_on_pool在同一個SortPool上執行，整個排序只開一次執行緒。
+//    d. 有號整數把sign bit反轉，float/double以保持順序的bit轉換(負數全部反轉，正數只反轉sign bit)變成unsigned key。
+//    parallel_sort(vec, thread_num, engine)為統一的入口，以Engine選擇quick_sort/sample_sort/radix_sort
+//    (不是整數或浮點數的型別選radix_sort時改用quick_sort)。
+// 9. quick_sort、sample_sort都不是stable的，依照key排序紀錄(record)時需要stable_merge_sort()：
+//    a. 先把每32個元素以insertion sort排好(sorting network不是stable的，這裡不能使用)，再由下而上(bottom-up)兩兩合併，每一輪的寬度加倍。
+//    b. 每一輪的合併也是平行的：整輪的輸出平均切給每條執行緒，以merge path (co-rank)二分搜尋出
+//       每個切點在兩個輸入中的位置，每條執行緒合併自己那一段，工作量與資料的分布無關，最後幾輪只剩一兩個合併時也是如此。
+//    c. 相等時先取左邊的元素，保持stable。
+//    d. 只在一開始配置一個與輸入一樣大的暫存buffer，每一輪在輸入與buffer之間來回。
+//    e. 一開始的insertion sort與每一輪的合併都以run_on_pool在同一個SortPool上執行，整個排序只開一次執行緒。
+// 10. 分類迴圈 if(arr[j] < pivot) std::swap(...) 有分支，亂數資料大約每兩個元素就預測錯一次。
+//    int的 < pivot 分類改由partition::kernel (Partition_Kernel.hpp)完成，執行時依照CPU選擇AVX-512、AVX2或scalar的版本。
+// 11. main：除了原本1000個元素的示範以外，比較100M個亂數int在有/沒有parallel_partition時的排序時間、
+//    quick_sort/sample_sort/radix_sort/std::sort(par)的排序時間(int以及double)、
+//    stable_merge_sort與std::stable_sort(par)排序紀錄的throughput以及peak RSS的增加量、
+//    分類kernel每個元素花費的cycle數(__rdtsc)、小區間以sorting network與insertion sort排序的時間，
+//    以及sorted、reversed、organ-pipe、few-unique等輸入的排序時間(與std::sort比較)。
+//    (執行參數可以指定元素個數)
 #include <iostream>
 #include <deque>
 #include <mutex>
@@ -12,9 +70,34 @@
 #include <condition_variable>
 #include <vector>
 #include <thread>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <climits>
+#include <string>
+#include <functional>
+#include <execution>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <type_traits>
+#include <fstream>
+#include <memory>
+#include <variant>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>   // __rdtsc
+#endif
+#include "Trace_Event.hpp"   // 定義ENABLE_TRACE時記錄Chrome trace events
+#include "Async_Logger.hpp"  // LOG()：不拿鎖、批次寫出的非同步logger
+#include "Sorting_Network.hpp"  // network::small_sort：小區間的sorting network
+#include "Partition_Kernel.hpp"  // partition::kernel：int分類的AVX2/AVX-512 kernel
 
 using namespace std::literals;
 
+struct NeverDone{                           // Queue的預設等待條件：只有佇列關閉時才結束
+    bool operator()() const { return false; }
+};
+
 template<typename T>
 class Queue{
     std::deque<T> dq_;
@@ -23,60 +106,712 @@ class Queue{
     std::condition_variable cv;
 public:
     void Enqueue(T val){
+        TRACE_SCOPE("Enqueue");
         {
             std::lock_guard<std::mutex> lk(m);
-            dq_.push_back(val);
+            dq_.push_back(std::move(val));
         }
         cv.notify_one();
     }
+    template<typename Range>
+    void EnqueueBulk(Range&& vals){        // 一整批任務只搶一次mutex。傳入暫存的range時把元素move進來。
+        TRACE_SCOPE("EnqueueBulk");
+        std::size_t n = 0;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            for(auto& val: vals){
+                if constexpr(std::is_lvalue_reference_v<Range>) dq_.push_back(val);
+                else dq_.push_back(std::move(val));
+                n++;
+            }
+        }
+        if(n == 1) cv.notify_one();        // 每一批只決定一次要叫醒幾個thread。
+        else if(n > 1) cv.notify_all();
+    }
     bool WaitandDequeue(T& value){
+        TRACE_SCOPE("WaitandDequeue");
         std::unique_lock<std::mutex> uk(m);
-        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        wait(uk, NeverDone{});
         if(dq_.empty()) return false;
-        value = dq_.front();
+        value = std::move(dq_.front());
         dq_.pop_front();
         return true;
     }
+    struct NeverAlone{
+        bool operator()(const T&) const { return false; }
+    };
+    // 一次最多拿n個任務，回傳0代表事情都做完了(佇列關閉，或是done()為true)。
+    // alone(x)為true的任務只會單獨被拿走 (例如同一個BlockJob的副本要分給不同的thread)。
+    template<typename OutputIt, typename Done = NeverDone, typename Alone = NeverAlone>
+    std::size_t WaitAndDequeueUpTo(std::size_t n, OutputIt out, Done done = Done{}, Alone alone = Alone{}){
+        TRACE_SCOPE("WaitAndDequeueUpTo");
+        std::unique_lock<std::mutex> uk(m);
+        wait(uk, done);
+        if(done()) return 0;
+        std::size_t k = 0;
+        while(k < n && !dq_.empty()){
+            bool single = alone(dq_.front());
+            if(single && k != 0) break;
+            *out++ = std::move(dq_.front());
+            dq_.pop_front();
+            k++;
+            if(single) break;
+        }
+        return k;
+    }
     void Close(){
         closed.store(true);
         cv.notify_all();
     }
+    int Idle() const { return idle.load(std::memory_order_relaxed); }   // 正在等待任務的thread數
+    // thread沒有任務可以做、準備睡著之前(拿著m)呼叫check()，回傳true時叫醒所有等待中的thread
+    // (例如全部的工作都做完了，要叫醒等待完成的呼叫端)。
+    void OnIdle(std::function<bool()> check){ on_idle = std::move(check); }
+private:
+    std::atomic<int> idle{0};
+    std::function<bool()> on_idle;
+    template<typename Done>
+    void wait(std::unique_lock<std::mutex>& uk, Done& done){
+        if(!dq_.empty() || closed.load() || done()) return;
+        if(on_idle && on_idle()) cv.notify_all();
+        idle++;
+        cv.wait(uk, [&]{return (!dq_.empty()||closed.load()||done());});
+        idle--;
+    }
 };
 
 struct Event{
     int from;
     int to;
+    int bad_allowed;                        // 還能容忍幾次不平均的分類，用完改用heapsort
+    bool leftmost;                          // true：arr[from-1]不是這個區間之前的pivot，不能拿來比較
+};
+
+struct Span{                                // [from, to)
+    int from;
+    int to;
+};
+
+// parallel_partition的一個步驟：f(0), ..., f(parts-1)由呼叫端以及來幫忙的worker分著做。
+struct BlockJob{
+    std::function<void(int)> f;
+    int parts;
+    std::atomic<int> next{0};               // 下一個還沒有人拿的block
+    std::atomic<int> done{0};               // 已經做完的block數
+    std::mutex m;
+    std::condition_variable cv;             // 最後一個block做完時叫醒在wait()中等待的呼叫端
+    void work(){
+        for(int k; (k = next.fetch_add(1, std::memory_order_relaxed)) < parts; ){
+            f(k);
+            if(done.fetch_add(1, std::memory_order_acq_rel) + 1 == parts){
+                {
+                    std::lock_guard<std::mutex> lk(m);   // 先拿一次m，正要睡著的呼叫端不會漏掉
+                }
+                cv.notify_all();
+            }
+        }
+    }
+    void wait(){                            // 睡到所有block都做完 (Jobs的cv不能拿來等：會吃掉給worker的notify_one)
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{ return done.load(std::memory_order_acquire) == parts; });
+    }
+};
+
+// pool中的任務：排序一個區間，或是幫忙做BlockJob (呼叫端可能已經自己做完了，所以以shared_ptr持有)。
+using Task = std::variant<Event, std::shared_ptr<BlockJob>>;
+
+constexpr std::size_t enqueue_batch = 16;   // 累積幾個子區間以後再一次放進Jobs (EnqueueBulk)。
+constexpr int flush_size = 1 << 16;         // 夠大的子區間立刻連同目前累積的一起放出去，避免一開始其他thread閒置。
+constexpr std::size_t dequeue_batch = 4;    // worker一次最多拿幾個任務 (WaitAndDequeueUpTo)。
+constexpr int partition_block_min = 1 << 17;  // parallel_partition中每條執行緒至少分到的元素個數。
+constexpr int parallel_partition_min = 1 << 20;  // 區間長度超過這個值時，分類改由多條執行緒一起做 (sort_with_pool傳入INT_MAX即為原本的做法)。
+constexpr int ninther_min = 128;            // 這個長度以上用ninther選pivot。
+constexpr int samplesort_buckets_per_thread = 4;
+constexpr int samplesort_oversample = 32;   // 每個bucket抽幾個樣本。
+
+// 排序用的thread pool：thread_num-1條worker，加上呼叫sort_ranges的執行緒自己。
+// 呼叫端不空轉等待：等待時也從Jobs拿任務來做，沒有任務時和worker一樣睡在Jobs上，
+// 最後一個worker做完、沒有工作可做時被叫醒。
+class SortPool{
+public:
+    // 每條執行緒自己的狀態，計數器只有自己會寫入(其他執行緒只在等待完成時讀取)。
+    struct alignas(64) Slot{
+        std::atomic<long long> spawned{0};  // 放進Jobs的Event個數
+        std::atomic<long long> finished{0}; // 做完的Event個數
+        std::vector<Event> batch;           // quick_sort切出來、還沒放進Jobs的子區間
+        void add(std::atomic<long long>& counter, long long n){
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+    };
+
+    Queue<Task> Jobs;
+    int partition_min;                      // 區間長度超過這個值時才考慮parallel_partition
+
+    explicit SortPool(int thread_num, bool verbose = false, int partition_min = parallel_partition_min)
+        : partition_min(partition_min), verbose_(verbose), thread_num_(thread_num), slots_(new Slot[thread_num]){
+        Jobs.OnIdle([this]{ return waiting_.load() && all_done(); });   // 最後一個做完的worker叫醒呼叫端
+        for(int i = 1; i < thread_num; i++){
+            workers_.push_back(std::thread{[this, i]{
+                TRACE_THREAD_NAME("worker");
+                work(slots_[i], NeverDone{});
+            }});
+        }
+    }
+    ~SortPool(){
+        Jobs.Close();
+        for(auto& t: workers_){
+            t.join();
+        }
+    }
+    SortPool(const SortPool&) = delete;
+    SortPool& operator=(const SortPool&) = delete;
+
+    // 以quick_sort排序vec中的每個區間(ranges)，全部做完才返回。
+    template<typename T>
+    void sort_ranges(std::vector<T>& vec, const std::vector<Event>& ranges);
+
+private:
+    std::function<void(const Event&, Slot&)> sort_event_;   // 這次sort_ranges的quick_sort
+    bool verbose_;                          // 每個worker每輪都讓出執行緒並輸出自己的id (示範用)
+    int thread_num_;
+    std::unique_ptr<Slot[]> slots_;         // [0]是呼叫sort_ranges的執行緒，[i]是第i條worker
+    std::atomic<bool> waiting_{false};      // 呼叫端正在sort_ranges中等待
+    std::vector<std::thread> workers_;
+
+    // 先加總finished再加總spawned：讀到的每個finished，它的Event被放出去時的spawned一定也讀得到，
+    // 兩者相等時，所有放出去的Event(以及它們再切出來的)都已經做完。
+    bool all_done() const {
+        long long finished = 0, spawned = 0;
+        for(int i = 0; i < thread_num_; i++) finished += slots_[i].finished.load(std::memory_order_acquire);
+        for(int i = 0; i < thread_num_; i++) spawned += slots_[i].spawned.load(std::memory_order_acquire);
+        return finished == spawned;
+    }
+
+    template<typename Done>
+    void work(Slot& self, Done done){
+        Task tasks[dequeue_batch];
+        self.batch.reserve(enqueue_batch);
+        std::size_t n;
+        auto alone = [](const Task& t){ return !std::holds_alternative<Event>(t); };   // BlockJob一次只拿一個
+        while((n = Jobs.WaitAndDequeueUpTo(dequeue_batch, tasks, done, alone)) > 0){
+            int events = 0;
+            for(std::size_t k = 0; k < n; k++){
+                if(auto* e = std::get_if<Event>(&tasks[k])){
+                    sort_event_(*e, self);
+                    events++;
+                }else{
+                    std::get<std::shared_ptr<BlockJob>>(tasks[k])->work();
+                    tasks[k] = Event{};         // 不再持有BlockJob
+                }
+            }
+            if(events != 0) self.add(self.finished, events);
+            if(verbose_){
+                std::this_thread::sleep_for(0.001s);   // Force to switch threads
+                LOG() << "[" << std::this_thread::get_id() << "]";
+            }
+        }
+    }
 };
 
+// 在pool上執行f(0), f(1), ..., f(parts-1)：放出parts-1個BlockJob給閒置的worker，自己也一起做，全部做完才返回。
+template<typename F>
+void run_on_pool(SortPool& pool, int parts, F f){
+    auto job = std::make_shared<BlockJob>();
+    job->f = std::move(f);
+    job->parts = parts;
+    pool.Jobs.EnqueueBulk(std::vector<Task>(parts - 1, job));
+    job->work();
+    job->wait();                            // 剩下的block已經被worker拿走，睡著等它們做完
+}
+
+// 分類的條件：x < pivot，以及 x <= pivot (等於前一個pivot時使用)
+template<typename T>
+struct Less{
+    T pivot;
+    bool operator()(const T& x) const { return x < pivot; }
+};
+template<typename T>
+struct LessEqual{
+    T pivot;
+    bool operator()(const T& x) const { return !(pivot < x); }
+};
+
+// 單執行緒分類一段區間，int的 < / <= 使用partition::kernel (Partition_Kernel.hpp)，其他的用原本的迴圈。
+template<typename T, typename Pred>
+int partition_block(T* first, T* last, Pred goes_left){
+    if constexpr(std::is_same_v<T, int> && std::is_same_v<Pred, Less<int>>){
+        return partition::kernel(first, last, goes_left.pivot);
+    }else if constexpr(std::is_same_v<T, int> && std::is_same_v<Pred, LessEqual<int>>){
+        if(goes_left.pivot < INT_MAX) return partition::kernel(first, last, goes_left.pivot + 1);
+    }
+    T* i = first;
+    for(T* j = first; j < last; j++){
+        if(goes_left(*j)){
+            std::swap(*i, *j);
+            i++;
+        }
+    }
+    return i - first;
+}
+
+// 把[first, last)分成 goes_left(x) 以及 !goes_left(x) 兩段，回傳分界點，結果與單執行緒的分類迴圈相同(只有段內的順序不同)。
+template<typename T, typename Pred>
+int parallel_partition(std::vector<T>& arr, int first, int last, Pred goes_left, int parts, SortPool& pool){
+    TRACE_SCOPE("parallel_partition", "from", first, "to", last);
+    auto bound = [=](int k){ return first + (int)((long long)(last - first) * k / parts); };
+
+    // a. 每條執行緒分類自己的block
+    std::vector<int> less(parts);
+    run_on_pool(pool, parts, [&](int k){
+        less[k] = partition_block(arr.data() + bound(k), arr.data() + bound(k + 1), goes_left);
+    });
+
+    // b. 分界點，以及放錯邊的區段
+    int mid = first;
+    for(int c: less) mid += c;
+    std::vector<Span> wrong_left, wrong_right;        // 左邊的 !goes_left、右邊的 goes_left
+    std::vector<long long> left_pre{0}, right_pre{0}; // 區段長度的prefix sum
+    for(int k = 0; k < parts; k++){
+        int b = bound(k), s = b + less[k], e = bound(k + 1);
+        if(s < std::min(e, mid)){
+            wrong_left.push_back({s, std::min(e, mid)});
+            left_pre.push_back(left_pre.back() + wrong_left.back().to - s);
+        }
+        if(std::max(b, mid) < s){
+            wrong_right.push_back({std::max(b, mid), s});
+            right_pre.push_back(right_pre.back() + s - wrong_right.back().from);
+        }
+    }
+    long long total = left_pre.back();
+    if(total == 0) return mid;
+
+    // c. 第k條執行緒負責交換第[total*k/parts, total*(k+1)/parts)個放錯邊的元素
+    run_on_pool(pool, parts, [&](int k){
+        long long from = total * k / parts, n = total * (k + 1) / parts - from;
+        auto seek = [from](const std::vector<Span>& spans, const std::vector<long long>& pre, std::size_t& idx){
+            idx = std::upper_bound(pre.begin(), pre.end(), from) - pre.begin() - 1;
+            return spans[idx].from + (int)(from - pre[idx]);
+        };
+        std::size_t a, b;
+        int pa = seek(wrong_left, left_pre, a), pb = seek(wrong_right, right_pre, b);
+        while(n > 0){
+            if(pa == wrong_left[a].to) pa = wrong_left[++a].from;
+            if(pb == wrong_right[b].to) pb = wrong_right[++b].from;
+            int len = (int)std::min<long long>(n, std::min(wrong_left[a].to - pa, wrong_right[b].to - pb));
+            std::swap_ranges(arr.begin() + pa, arr.begin() + pa + len, arr.begin() + pb);
+            pa += len;
+            pb += len;
+            n -= len;
+        }
+    });
+    return mid;
+}
+
+// Classification：goes_left(x)的元素放到[first, 分界點)，夠長的區間在pool有閒置的worker時使用parallel_partition。
+template<typename T, typename Pred>
+int classify(std::vector<T>& arr, int first, int last, Pred goes_left, SortPool& pool){
+    if((last - first) >= pool.partition_min){
+        int parts = std::min(pool.Jobs.Idle() + 1, (last - first) / partition_block_min);   // Idle()最多thread_num-1
+        if(parts > 1) return parallel_partition(arr, first, last, goes_left, parts, pool);
+    }
+    return first + partition_block(arr.data() + first, arr.data() + last, goes_left);
+}
+
+inline int log2_floor(int n){
+    int l = 0;
+    while(n >>= 1) l++;
+    return l;
+}
+
+template<typename T, typename Comp = std::less<>>
+void insertion_sort(std::vector<T>& arr, int first, int last, Comp comp = Comp{}){
+    for(int i = first + 1; i < last; i++){
+        T v = std::move(arr[i]);
+        int j = i;
+        for(; j > first && comp(v, arr[j - 1]); j--){
+            arr[j] = std::move(arr[j - 1]);
+        }
+        arr[j] = std::move(v);
+    }
+}
+
+// 把a, b, c三個位置的元素排好，中位數在b。
+template<typename T>
+void sort3(std::vector<T>& arr, int a, int b, int c){
+    if(arr[b] < arr[a]) std::swap(arr[a], arr[b]);
+    if(arr[c] < arr[b]) std::swap(arr[b], arr[c]);
+    if(arr[b] < arr[a]) std::swap(arr[a], arr[b]);
+}
+
+// 選pivot (median-of-3或ninther) 並放到arr[start]。
+template<typename T>
+void choose_pivot(std::vector<T>& arr, int start, int end){
+    int half = start + (end - start) / 2;
+    if(end - start >= ninther_min){
+        sort3(arr, start, half, end - 1);
+        sort3(arr, start + 1, half - 1, end - 2);
+        sort3(arr, start + 2, half + 1, end - 3);
+        sort3(arr, half - 1, half, half + 1);
+    }else{
+        sort3(arr, start, half, end - 1);
+    }
+    std::swap(arr[start], arr[half]);
+}
+
+// 分類太不平均時，把兩邊幾個固定位置的元素互換，破壞造成不平均的規律(例如organ-pipe)。
+template<typename T>
+void break_pattern(std::vector<T>& arr, int first, int last){
+    int len = last - first;
+    if(len < network::small_sort_max) return;
+    std::swap(arr[first], arr[first + len / 4]);
+    std::swap(arr[last - 1], arr[last - len / 4]);
+    if(len >= ninther_min){
+        std::swap(arr[first + 1], arr[first + len / 4 + 1]);
+        std::swap(arr[first + 2], arr[first + len / 4 + 2]);
+        std::swap(arr[last - 2], arr[last - len / 4 - 1]);
+        std::swap(arr[last - 3], arr[last - len / 4 - 2]);
+    }
+}
+
+// 整段已經排好，或完全反序(反轉以後就排好了)時回傳true。
 template<typename T>
-void quick_sort(std::vector<T>& arr, int start, int end, Queue<Event>& Jobs, std::atomic<int>& ct){
+bool sorted_run(std::vector<T>& arr, int start, int end){
+    auto b = arr.begin() + start, e = arr.begin() + end;
+    if(!(arr[start + 1] < arr[start])) return std::is_sorted(b, e);
+    if(!std::is_sorted(b, e, std::greater<T>())) return false;
+    std::reverse(b, e);
+    return true;
+}
+
+// self.batch是呼叫端(worker)自己的buffer，切出來的子區間先存在這邊，一次付一次鎖以及一次叫醒的成本；
+// 每次呼叫都重複使用同一個buffer，遞迴的熱路徑上不會配置記憶體。回傳時batch一定是空的。
+template<typename T>
+void quick_sort(std::vector<T>& arr, int start, int end, int bad_allowed, bool leftmost, SortPool& pool,
+                SortPool::Slot& self){
+    TRACE_SCOPE("quick_sort", "from", start, "to", end);
+    auto& batch = self.batch;
+    auto flush = [&]{
+        if(batch.empty()) return;
+        self.add(self.spawned, batch.size());   // 先計數再放進Jobs：finished不會超過spawned
+        pool.Jobs.EnqueueBulk(batch);
+        batch.clear();
+    };
     while(true){
-        if(start == end) return;
-
-        // Classification (quick_sort 以第一個元素當成是參考值(pivot)下去進行分類)
-        int i = start+1;
-        for(int j = i; j < end; j++){
-            if(arr[j] < arr[start]){
-                std::swap(arr[i], arr[j]);
-                i++;
-            }
+        int len = end - start;
+        if(len <= network::small_sort_max){
+            network::small_sort(arr.data() + start, len);
+            flush();
+            return;
+        }
+        if(sorted_run(arr, start, end)){
+            flush();
+            return;
+        }
+        if(bad_allowed <= 0){               // 不平均的分類太多次：改用heapsort，保證O(n log n)
+            std::make_heap(arr.begin() + start, arr.begin() + end);
+            std::sort_heap(arr.begin() + start, arr.begin() + end);
+            flush();
+            return;
         }
+
+        // Classification (quick_sort 以頭、中、尾的中位數當成是參考值(pivot)，先換到第一個元素，再下去進行分類)
+        choose_pivot(arr, start, end);
+        const T pivot = arr[start];
+        if(!leftmost && !(arr[start-1] < pivot)){
+            // 前一個元素(上一次的pivot)等於pivot：區間內沒有比pivot小的元素，等於pivot的都放左邊，左邊就排好了。
+            int i = classify(arr, start+1, end, LessEqual<T>{pivot}, pool);
+            std::swap(arr[i-1], arr[start]);
+            start = i;
+            leftmost = false;
+            continue;
+        }
+        int i = classify(arr, start+1, end, Less<T>{pivot}, pool);
         // Substitution (將參考值置換擺到正確的位置(擁有正確的百分點位置(percentile)))
         int mid = i-1;
         std::swap(arr[mid], arr[start]);
+        if(std::min(mid - start, end - mid - 1) < len / 8){
+            bad_allowed--;
+            break_pattern(arr, start, mid);
+            break_pattern(arr, mid+1, end);
+        }
 
-        if((mid - start) > 10){             // 優化技巧：當長度大於特定的長度時再切分給別的thread去做，因為如果長度太小將它切分出去的成本將大於自己把它做完的成本。
-            Jobs.Enqueue({start, mid});
-            ct++;
+        if((mid - start) > network::small_sort_max){   // 優化技巧：當長度大於特定的長度時再切分給別的thread去做，因為如果長度太小將它切分出去的成本將大於自己把它做完的成本。
+            batch.push_back({start, mid, bad_allowed, leftmost});
+            if(batch.size() >= enqueue_batch || (mid - start) >= flush_size) flush();
         }else{
-            quick_sort(arr, start, mid, Jobs, ct);
+            network::small_sort(arr.data() + start, mid - start);
         }
-        start = mid+1;                      // 優化技巧：當自己目前這輪運算已經做完的時候，緊接著再做下一輪的運算(while)，
+        start = mid+1;
+        leftmost = false;                   // 優化技巧：當自己目前這輪運算已經做完的時候，緊接著再做下一輪的運算(while)，
                                             // 而不是丟給其他thread做，然後自己閒置。充分利用資源，自產幫忙自銷。
     }
 }
 
-int main(){
+template<typename T>
+void SortPool::sort_ranges(std::vector<T>& vec, const std::vector<Event>& ranges){
+    if(ranges.empty()) return;
+    sort_event_ = [this, &vec](const Event& e, Slot& self){
+        quick_sort(vec, e.from, e.to, e.bad_allowed, e.leftmost, *this, self);
+    };
+    Slot& self = slots_[0];
+    waiting_.store(true);
+    self.add(self.spawned, ranges.size());
+    Jobs.EnqueueBulk(ranges);
+    work(self, [this]{ return all_done(); });   // 原本是 while(ct!=0) std::this_thread::yield(); 空轉等待
+    waiting_.store(false);
+}
+
+// 以thread_num條執行緒排序整個vec；verbose時每個worker每輪都讓出執行緒並輸出自己的id (示範用)。
+// 區間長度超過partition_min時，分類可以由閒置的worker一起做(parallel_partition)。
+template<typename T>
+void sort_with_pool(std::vector<T>& vec, int thread_num, bool verbose, int partition_min = parallel_partition_min){
+    int n = vec.size();
+    SortPool pool(thread_num, verbose, partition_min);
+    pool.sort_ranges(vec, {{0, n, log2_floor(n) + 1, true}});
+}
+
+// Samplesort：與sort_with_pool的用法相同。
+template<typename T>
+void sample_sort(std::vector<T>& vec, int thread_num, bool verbose){
+    TRACE_SCOPE("sample_sort", "size", vec.size());
+    int n = vec.size();
+    int buckets = std::min(thread_num * samplesort_buckets_per_thread, 1 << 16);
+    if(n < buckets * samplesort_oversample * 4){     // 太小：直接用quick_sort
+        sort_with_pool(vec, thread_num, verbose);
+        return;
+    }
+
+    // a. 抽樣並選出splitter (去掉重複的，相同的值只會落在同一個bucket)
+    std::mt19937 gen(n);
+    std::vector<T> sample(buckets * samplesort_oversample);
+    for(auto& x: sample) x = vec[gen() % n];
+    std::sort(sample.begin(), sample.end());
+    std::vector<T> splitters;
+    for(int b = 1; b < buckets; b++){
+        splitters.push_back(sample[b * samplesort_oversample]);
+    }
+    splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+    buckets = splitters.size() + 1;
+
+    // b. 每條執行緒分類自己的block，並累計自己的histogram
+    SortPool pool(thread_num, verbose);     // b、c、d三個步驟都在同一個pool上執行，不再另外開執行緒
+    auto bound = [=](int k){ return (int)((long long)n * k / thread_num); };
+    std::vector<std::uint16_t> bucket_of(n);
+    std::vector<std::vector<int>> offset(thread_num, std::vector<int>(buckets));
+    run_on_pool(pool, thread_num, [&](int k){
+        auto& count = offset[k];
+        for(int i = bound(k); i < bound(k + 1); i++){
+            int b = std::upper_bound(splitters.begin(), splitters.end(), vec[i]) - splitters.begin();
+            bucket_of[i] = b;
+            count[b]++;
+        }
+    });
+
+    // c. prefix sum：第k條執行緒在bucket b的寫入位置 = 前面所有bucket的大小 + 前面的執行緒在bucket b中的個數
+    std::vector<Event> ranges;
+    int sum = 0;
+    for(int b = 0; b < buckets; b++){
+        int begin = sum;
+        for(int k = 0; k < thread_num; k++){
+            int c = offset[k][b];
+            offset[k][b] = sum;
+            sum += c;
+        }
+        if(sum - begin > 1) ranges.push_back({begin, sum, log2_floor(sum - begin) + 1, true});
+    }
+    std::vector<T> tmp(n);
+    run_on_pool(pool, thread_num, [&](int k){
+        auto& pos = offset[k];
+        for(int i = bound(k); i < bound(k + 1); i++){
+            tmp[pos[bucket_of[i]]++] = std::move(vec[i]);
+        }
+    });
+    vec.swap(tmp);
+
+    // d. 每個bucket由pool上的quick_sort排序 (bucket之間互相獨立，前一個bucket的元素不能拿來比較，所以leftmost = true)
+    pool.sort_ranges(vec, ranges);
+}
+
+// radix_sort可以處理的型別：整數以及float/double。
+template<typename T>
+constexpr bool radix_sortable = (std::is_integral_v<T> && !std::is_same_v<T, bool>) ||
+                                (std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8));
+
+// 把T轉成順序相同的unsigned key。
+template<typename T>
+auto radix_key(T x){
+    if constexpr(std::is_integral_v<T>){
+        using Key = std::make_unsigned_t<T>;
+        Key k = (Key)x;
+        if constexpr(std::is_signed_v<T>) k ^= Key(1) << (sizeof(T) * 8 - 1);
+        return k;
+    }else{
+        using Key = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+        Key k;
+        std::memcpy(&k, &x, sizeof(k));
+        const Key sign = Key(1) << (sizeof(T) * 8 - 1);
+        return (k & sign) ? Key(~k) : Key(k | sign);
+    }
+}
+
+constexpr int radix_bits = 8;
+constexpr int radix_size = 1 << radix_bits;
+
+// 平行的LSD radix sort。
+template<typename T>
+void radix_sort(std::vector<T>& vec, int thread_num){
+    static_assert(radix_sortable<T>, "radix_sort only supports integral and floating-point keys");
+    TRACE_SCOPE("radix_sort", "size", vec.size());
+    constexpr int wc = std::max<int>(1, 64 / sizeof(T));    // 一個cache line放得下幾個元素
+    std::size_t n = vec.size();
+    std::vector<T> tmp(n);
+    T* src = vec.data();
+    T* dst = tmp.data();
+    auto bound = [=](int k){ return n * k / thread_num; };
+    std::vector<std::array<std::size_t, radix_size>> offset(thread_num);
+    std::vector<std::vector<T>> wc_buf(thread_num, std::vector<T>(radix_size * wc));   // 每個block的write-combining buffer
+    SortPool pool(thread_num);              // 每一輪的兩個步驟都在同一個pool上執行，不再每一輪開執行緒
+
+    for(int shift = 0; shift < (int)sizeof(T) * 8; shift += radix_bits){
+        auto digit = [shift](T x){ return (radix_key(x) >> shift) & (radix_size - 1); };
+
+        // a. 每條執行緒的histogram
+        run_on_pool(pool, thread_num, [&](int k){
+            auto& count = offset[k];
+            count.fill(0);
+            for(std::size_t i = bound(k); i < bound(k + 1); i++) count[digit(src[i])]++;
+        });
+
+        // b. prefix sum (全部落在同一個digit時這一輪不用搬)
+        std::size_t sum = 0;
+        bool skip = false;
+        for(int d = 0; d < radix_size; d++){
+            std::size_t begin = sum;
+            for(int k = 0; k < thread_num; k++){
+                std::size_t c = offset[k][d];
+                offset[k][d] = sum;
+                sum += c;
+            }
+            if(sum - begin == n) skip = true;
+        }
+        if(skip) continue;
+
+        // c. 經過write-combining buffer scatter到dst
+        run_on_pool(pool, thread_num, [&](int k){
+            auto& pos = offset[k];
+            auto& buf = wc_buf[k];
+            std::array<int, radix_size> fill{};
+            for(std::size_t i = bound(k); i < bound(k + 1); i++){
+                auto d = digit(src[i]);
+                buf[d * wc + fill[d]++] = src[i];
+                if(fill[d] == wc){
+                    std::memcpy(dst + pos[d], &buf[d * wc], wc * sizeof(T));
+                    pos[d] += wc;
+                    fill[d] = 0;
+                }
+            }
+            for(int d = 0; d < radix_size; d++){
+                std::memcpy(dst + pos[d], &buf[d * wc], fill[d] * sizeof(T));
+            }
+        });
+        std::swap(src, dst);
+    }
+    if(src != vec.data()) vec.swap(tmp);                    // 結果在tmp中 (有些輪被跳過時)
+}
+
+constexpr int merge_run = 32;               // stable_merge_sort一開始以insertion sort排好的長度。
+
+// 合併a[0, na)與b[0, nb)時，輸出的前d個元素中有幾個來自a (相等時a優先)。
+template<typename T, typename Comp>
+std::size_t co_rank(std::size_t d, const T* a, std::size_t na, const T* b, std::size_t nb, Comp comp){
+    std::size_t lo = d > nb ? d - nb : 0, hi = std::min(d, na);
+    while(lo < hi){
+        std::size_t i = lo + (hi - lo) / 2;
+        if(!comp(b[d - i - 1], a[i])) lo = i + 1;           // a[i] <= b[d-i-1]：a[i]也在前d個之中
+        else hi = i;
+    }
+    return lo;
+}
+
+// 平行、stable的merge sort。
+template<typename T, typename Comp = std::less<>>
+void stable_merge_sort(std::vector<T>& vec, int thread_num, Comp comp = Comp{}){
+    TRACE_SCOPE("stable_merge_sort", "size", vec.size());
+    std::size_t n = vec.size();
+    std::size_t runs = (n + merge_run - 1) / merge_run;
+    SortPool pool(thread_num);              // run與每一輪的合併都在同一個pool上執行
+    run_on_pool(pool, thread_num, [&](int k){
+        for(std::size_t r = runs * k / thread_num; r < runs * (k + 1) / thread_num; r++){
+            insertion_sort(vec, r * merge_run, std::min(n, (r + 1) * merge_run), comp);
+        }
+    });
+
+    std::vector<T> tmp(n);                                  // 唯一的暫存buffer
+    T* src = vec.data();
+    T* dst = tmp.data();
+    for(std::size_t w = merge_run; w < n; w *= 2){
+        run_on_pool(pool, thread_num, [&](int k){
+            std::size_t lo = n * k / thread_num, hi = n * (k + 1) / thread_num;
+            while(lo < hi){                                 // [lo, hi)可能跨過好幾個合併
+                std::size_t base = lo / (2 * w) * (2 * w);
+                std::size_t na = std::min(w, n - base), nb = std::min(w, n - base - na);
+                const T* a = src + base;
+                const T* b = a + na;
+                std::size_t end = std::min(hi, base + na + nb);
+                std::size_t d0 = lo - base, d1 = end - base;
+                std::size_t i0 = co_rank(d0, a, na, b, nb, comp), i1 = co_rank(d1, a, na, b, nb, comp);
+                std::merge(a + i0, a + i1, b + (d0 - i0), b + (d1 - i1), dst + lo, comp);
+                lo = end;
+            }
+        });
+        std::swap(src, dst);
+    }
+    if(src != vec.data()) vec.swap(tmp);
+}
+
+enum class Engine{ QuickSort, SampleSort, RadixSort, StableMergeSort };
+
+// 統一的入口：以thread_num條執行緒排序整個vec。
+template<typename T>
+void parallel_sort(std::vector<T>& vec, int thread_num, Engine engine = Engine::QuickSort, bool verbose = false){
+    switch(engine){
+    case Engine::QuickSort:
+        sort_with_pool(vec, thread_num, verbose);
+        break;
+    case Engine::SampleSort:
+        sample_sort(vec, thread_num, verbose);
+        break;
+    case Engine::RadixSort:
+        if constexpr(radix_sortable<T>) radix_sort(vec, thread_num);
+        else sort_with_pool(vec, thread_num, verbose);
+        break;
+    case Engine::StableMergeSort:
+        stable_merge_sort(vec, thread_num);
+        break;
+    }
+}
+
+struct Record{
+    int key;
+    int seq;                                // 原本的位置，用來檢查是否stable
+};
+
+// 從/proc/self/status讀取某一欄(kB)
+long read_status_kb(const std::string& key){
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while(std::getline(in, line)){
+        if(line.rfind(key + ":", 0) == 0) return std::stol(line.substr(key.size() + 1));
+    }
+    return -1;
+}
+
+// 把VmHWM(peak RSS)重設成目前的RSS (Linux 4.0以上)
+void reset_peak_rss(){
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+int main(int argc, char* argv[]){
     int thread_num = std::thread::hardware_concurrency();
     std::cout << "Avaliable Threads: " << thread_num << std::endl;
     std::cout << "[" << std::this_thread::get_id() << "]";
@@ -92,40 +827,148 @@ int main(){
     }
     std::cout << std::endl;
 
-    std::atomic<int> ct{0};
-    Queue<Event> Jobs;
-    std::vector<std::thread> workers;
-    Jobs.Enqueue({0, (int)vec.size()});
-    ct++;
-    for(int i = 0; i < thread_num; i++){
-        workers.push_back(std::thread{[&Jobs, &vec, &ct]{
-            Event event;
-            while(Jobs.WaitandDequeue(event)){
-                quick_sort(vec, event.from, event.to, Jobs, ct);
-                ct--;
-                std::this_thread::sleep_for(0.001s);   // Force to switch threads
-                std::cout << "[" << std::this_thread::get_id() << "]";
+    sort_with_pool(vec, thread_num, true);
+
+    async_log::Logger::instance().flush();   // 先把worker的紀錄寫完，再使用std::cout
+    std::cout << std::endl;
+
+    for(auto& e: vec){
+        std::cout << e << " ";
+    }
+    std::cout << std::endl;
+
+    // Benchmark：亂數資料
+    int big = argc > 1 ? std::stoi(argv[1]) : 100000000;
+    std::vector<int> data(big);
+    std::mt19937 gen(0);
+    for(auto& e: data) e = gen() % big;
+
+    auto measure = [&](const std::string& name, int threshold){
+        std::vector<int> v = data;
+        auto start = std::chrono::steady_clock::now();
+        sort_with_pool(v, thread_num, false, threshold);
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << name << ms << " ms" << (std::is_sorted(v.begin(), v.end()) ? "" : " (NOT SORTED)") << std::endl;
+        return ms;
+    };
+    std::cout << "sorting " << big << " ints with " << thread_num << " workers" << std::endl;
+    double serial = measure("  serial classification:   ", INT_MAX);
+    double parallel = measure("  parallel_partition:      ", parallel_partition_min);
+    std::cout << "  speedup: " << serial / parallel << "x" << std::endl;
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Benchmark：分類kernel每個元素花費的cycle數 (pivot為中位數，亂數資料)
+    {
+        std::vector<int> block(data.begin(), data.begin() + std::min(big, 1 << 20)), work(block.size());
+        int pivot = big / 2;
+        auto cycles = [&](partition::Kernel kernel){
+            constexpr int reps = 20;
+            unsigned long long total = 0;
+            for(int r = 0; r < reps; r++){
+                work = block;
+                unsigned long long t0 = __rdtsc();
+                kernel(work.data(), work.data() + work.size(), pivot);
+                total += __rdtsc() - t0;
             }
-        }});
-    } 
+            return (double)total / reps / work.size();
+        };
+        std::cout << "partition kernel, cycles per element:" << std::endl;
+        std::cout << "  scalar:  " << cycles(partition::scalar) << std::endl;
+        if(__builtin_cpu_supports("avx2")) std::cout << "  AVX2:    " << cycles(partition::avx2) << std::endl;
+        if(__builtin_cpu_supports("avx512f")) std::cout << "  AVX-512: " << cycles(partition::avx512) << std::endl;
+    }
+#endif
 
-    while(ct!=0){                     // <- This pattern is busy waiting. (ct 是用來確認工作是否已經全部做完了，
-                                      //    這邊要注意在不能只看Jobs是否已經是空的來判斷工作是否已經全部做完，
-                                      //    因為有可能是雖然Jobs為空，但有thread正在處理最後一份工作，
-                                      //    它剛拿走去做，但是還沒做完，做到一半，可能在後續做的過程中又會再塞新的event進到Jobs裡。)
-        std::this_thread::yield();    // <- This pattern will force to release the resource temporarily during busy waiting.
+    // Benchmark：leaf case，把data切成長度為len的小區間各自排序
+    std::cout << "small ranges, ns per element: network::small_sort / insertion sort" << std::endl;
+    for(int len: {4, 8, 16, 24, 32}){
+        auto leaf = [&](auto&& sort){
+            std::vector<int> v(data.begin(), data.begin() + std::min(big, 1 << 22) / len * len);
+            auto start = std::chrono::steady_clock::now();
+            for(std::size_t i = 0; i < v.size(); i += len) sort(v.data() + i);
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::nano>(end - start).count() / v.size();
+        };
+        double net = leaf([len](int* v){ network::small_sort(v, len); });
+        double ins = leaf([len](int* v){ network::insertion_sort(v, 1, len); });
+        std::cout << "  " << len << ":\t" << net << " / " << ins << std::endl;
     }
-    Jobs.Close();
 
-    for(auto& t: workers){
-        t.join();
+    // Benchmark：quick_sort / sample_sort / radix_sort / std::sort(par) (Course Notes/Parallelism/quick_sort.cpp)
+    auto engines = [&](const auto& input){
+        auto run = [&](const std::string& name, auto&& sort){
+            auto v = input;
+            auto start = std::chrono::steady_clock::now();
+            sort(v);
+            auto end = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            std::cout << name << ms << " ms" << (std::is_sorted(v.begin(), v.end()) ? "" : " (NOT SORTED)") << std::endl;
+        };
+        run("  quick_sort:              ", [&](auto& v){ parallel_sort(v, thread_num, Engine::QuickSort); });
+        run("  sample_sort:             ", [&](auto& v){ parallel_sort(v, thread_num, Engine::SampleSort); });
+        run("  radix_sort:              ", [&](auto& v){ parallel_sort(v, thread_num, Engine::RadixSort); });
+        run("  stable_merge_sort:       ", [&](auto& v){ parallel_sort(v, thread_num, Engine::StableMergeSort); });
+        run("  std::sort(par):          ", [&](auto& v){ std::sort(std::execution::par, v.begin(), v.end()); });
+    };
+    engines(data);
+    {
+        std::vector<double> data_d(big);
+        std::normal_distribution<double> dist(0.0, 1e6);
+        for(auto& e: data_d) e = dist(gen);
+        std::cout << "sorting " << big << " doubles with " << thread_num << " workers" << std::endl;
+        engines(data_d);
     }
 
-    std::cout << std::endl;
+    // Benchmark：依照key穩定排序紀錄 (key只有big/16種，相同key的紀錄必須保持原本的順序)
+    {
+        std::vector<Record> records(big);
+        for(int i = 0; i < big; i++) records[i] = {(int)(gen() % (big / 16 + 1)), i};
+        auto by_key = [](const Record& a, const Record& b){ return a.key < b.key; };
+        std::cout << "stable sorting " << big << " records (" << sizeof(Record) << " bytes) by key" << std::endl;
+        auto run = [&](const std::string& name, auto&& sort){
+            std::vector<Record> v = records;
+            reset_peak_rss();
+            long rss_before = read_status_kb("VmRSS");
+            auto start = std::chrono::steady_clock::now();
+            sort(v);
+            auto end = std::chrono::steady_clock::now();
+            long extra_mb = std::max(0L, read_status_kb("VmHWM") - rss_before) / 1024;
+            double s = std::chrono::duration<double>(end - start).count();
+            bool ok = std::is_sorted(v.begin(), v.end(), [](const Record& a, const Record& b){
+                return a.key < b.key || (a.key == b.key && a.seq < b.seq);
+            });
+            std::cout << name << big / s / 1e6 << " M records/s, peak RSS +" << extra_mb << " MB"
+                      << (ok ? "" : " (NOT STABLE)") << std::endl;
+        };
+        run("  stable_merge_sort:       ", [&](auto& v){ stable_merge_sort(v, thread_num, by_key); });
+        run("  std::stable_sort(par):   ", [&](auto& v){ std::stable_sort(std::execution::par, v.begin(), v.end(), by_key); });
+    }
 
-    for(auto& e: vec){
-        std::cout << e << " ";
+    // Benchmark：各種輸入的排列方式 (原本以第一個元素當pivot時，sorted以及reversed會退化成O(n^2))
+    std::vector<std::pair<std::string, std::function<int(int)>>> patterns{
+        {"random:     ", [&](int){ return (int)(gen() % big); }},
+        {"sorted:     ", [&](int i){ return i; }},
+        {"reversed:   ", [&](int i){ return big - i; }},
+        {"organ-pipe: ", [&](int i){ return std::min(i, big - i); }},
+        {"few-unique: ", [&](int){ return (int)(gen() % 16); }},
+    };
+    std::cout << "input patterns (" << big << " ints): quick_sort with pool / std::sort" << std::endl;
+    for(auto& [name, make]: patterns){
+        for(int i = 0; i < big; i++) data[i] = make(i);
+        std::vector<int> v = data;
+        auto start = std::chrono::steady_clock::now();
+        sort_with_pool(v, thread_num, false);
+        auto end = std::chrono::steady_clock::now();
+        double pool_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        bool ok = std::is_sorted(v.begin(), v.end());
+        v = data;
+        start = std::chrono::steady_clock::now();
+        std::sort(v.begin(), v.end());
+        end = std::chrono::steady_clock::now();
+        double std_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "  " << name << pool_ms << " ms / " << std_ms << " ms" << (ok ? "" : " (NOT SORTED)") << std::endl;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,318 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Quick_Sort_with_Simple_Thread_Pool.cpp中，quick_sort()把每一段長度大於10的子區間都丟回同一個
+//    全域的Queue<Event>，所有的worker都在搶同一把鎖，而且剛切出來、還在自己cache裡的子區間
+//    很可能被別的核心拿走(失去cache locality)。
+// 2. Work-stealing scheduler：每個worker都有一個自己的Chase-Lev deque。
+//    a. 擁有者(owner)從bottom端push/pop (LIFO)：自己剛切出來的子區間最熱，優先處理，
+//       而且大部分時候不需要任何CAS。
+//    b. 閒置的worker隨機挑一個受害者(victim)，從top端偷(steal, FIFO)：偷到的是最早切出來、
+//       也就是最大的子區間，一次偷就可以換到最多的工作量，偷的次數因此變少。
+//    c. 只有在deque只剩最後一個元素時，owner和thief才需要用CAS競爭top。
+// 3. deque滿了會自動擴充成兩倍大小，舊的陣列保留到deque解構時才釋放(thief可能還在讀)。
+// 4. main為benchmark：在1..N個執行緒下比較global queue版本與work-stealing版本排序10M+個元素的時間。
+//    (注意：資料使用亂數，因為以第一個元素當pivot時，反序的輸入會使quick_sort退化成O(n^2)。)
+//    兩個版本長度在network::small_sort_max以下的子區間都交給Sorting_Network.hpp的sorting network，只比較排程的差異。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include "Sorting_Network.hpp"
+
+using namespace std::literals;
+
+constexpr std::size_t cache_line_size = 64;
+
+struct Event{
+    int from;
+    int to;
+};
+
+/* -------------------- Global queue version (Quick_Sort_with_Simple_Thread_Pool.cpp) -------------------- */
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(val);
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = dq_.front();
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+template<typename T>
+void quick_sort(std::vector<T>& arr, int start, int end, Queue<Event>& Jobs, std::atomic<int>& ct){
+    while(true){
+        if(end - start <= network::small_sort_max){      // 小區間交給sorting network (Sorting_Network.hpp)
+            network::small_sort(arr.data() + start, end - start);
+            return;
+        }
+        int i = start+1;
+        for(int j = i; j < end; j++){
+            if(arr[j] < arr[start]){
+                std::swap(arr[i], arr[j]);
+                i++;
+            }
+        }
+        int mid = i-1;
+        std::swap(arr[mid], arr[start]);
+        if((mid - start) > 10){
+            ct++;
+            Jobs.Enqueue({start, mid});
+        }else{
+            quick_sort(arr, start, mid, Jobs, ct);
+        }
+        start = mid+1;
+    }
+}
+
+template<typename T>
+void global_queue_sort(std::vector<T>& vec, int thread_num){
+    std::atomic<int> ct{1};
+    Queue<Event> Jobs;
+    Jobs.Enqueue({0, (int)vec.size()});
+    std::vector<std::thread> workers;
+    for(int i = 0; i < thread_num; i++){
+        workers.push_back(std::thread{[&Jobs, &vec, &ct]{
+            Event event;
+            while(Jobs.WaitandDequeue(event)){
+                quick_sort(vec, event.from, event.to, Jobs, ct);
+                ct--;
+            }
+        }});
+    }
+    while(ct!=0){
+        std::this_thread::yield();
+    }
+    Jobs.Close();
+    for(auto& t: workers){
+        t.join();
+    }
+}
+
+/* -------------------- Work-stealing version -------------------- */
+// Chase-Lev deque (Lê, Pop, Cohen, Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models")
+// T必須是trivially copyable且std::atomic<T>為lock-free (e.g. Event是兩個int)。
+template<typename T>
+class WorkStealingDeque{
+    struct Array{
+        std::int64_t cap;
+        std::unique_ptr<std::atomic<T>[]> buf;
+        explicit Array(std::int64_t c): cap(c), buf(new std::atomic<T>[c]){}
+        T get(std::int64_t i) const { return buf[i & (cap - 1)].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, T x){ buf[i & (cap - 1)].store(x, std::memory_order_relaxed); }
+    };
+    alignas(cache_line_size) std::atomic<std::int64_t> top{0};      // thief 端
+    alignas(cache_line_size) std::atomic<std::int64_t> bottom{0};   // owner 端
+    std::atomic<Array*> array;
+    std::vector<std::unique_ptr<Array>> arrays;                     // 只有owner會擴充，因此不需要保護
+
+    Array* grow(Array* a, std::int64_t b, std::int64_t t){
+        auto bigger = std::make_unique<Array>(a->cap * 2);
+        for(std::int64_t i = t; i < b; i++) bigger->put(i, a->get(i));
+        Array* raw = bigger.get();
+        arrays.push_back(std::move(bigger));
+        array.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+public:
+    explicit WorkStealingDeque(std::int64_t capacity = 256){
+        arrays.push_back(std::make_unique<Array>(capacity));
+        array.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    // owner only
+    void push(T x){
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        Array* a = array.load(std::memory_order_relaxed);
+        if(b - t > a->cap - 1) a = grow(a, b, t);
+        a->put(b, x);
+        bottom.store(b + 1, std::memory_order_release);     // 發布給thief
+    }
+
+    // owner only (LIFO)
+    bool pop(T& x){
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        if(t > b){                          // 空的
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        x = a->get(b);
+        if(t == b){                         // 最後一個元素：和thief搶
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread (FIFO)
+    bool steal(T& x){
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b) return false;
+        Array* a = array.load(std::memory_order_acquire);
+        x = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+};
+
+class WorkStealingScheduler{
+    struct alignas(cache_line_size) Worker{
+        WorkStealingDeque<Event> dq;
+        std::minstd_rand rng;
+    };
+    std::vector<std::unique_ptr<Worker>> workers_;
+    alignas(cache_line_size) std::atomic<int> pending{0};   // 還沒做完的Event數量
+    static inline thread_local int self = 0;                // 目前執行緒對應的worker編號
+
+    bool try_steal(Event& event){
+        int n = workers_.size();
+        if(n == 1) return false;
+        auto& rng = workers_[self]->rng;
+        for(int attempt = 0; attempt < 2 * n; attempt++){
+            int victim = rng() % n;
+            if(victim != self && workers_[victim]->dq.steal(event)) return true;
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingScheduler(int thread_num){
+        for(int i = 0; i < thread_num; i++){
+            workers_.push_back(std::make_unique<Worker>());
+            workers_.back()->rng.seed(i + 1);
+        }
+    }
+
+    // 把子區間放進自己的deque (只能由worker呼叫)
+    void spawn(Event event){
+        pending.fetch_add(1, std::memory_order_relaxed);
+        workers_[self]->dq.push(event);
+    }
+
+    template<typename F>
+    void run(Event root, F&& body){
+        pending.store(1, std::memory_order_relaxed);
+        workers_[0]->dq.push(root);                         // 在worker啟動前放入，之後只有worker 0會push
+        std::vector<std::thread> threads;
+        for(int i = 0; i < (int)workers_.size(); i++){
+            threads.push_back(std::thread{[this, i, &body]{
+                self = i;
+                Event event;
+                int idle = 0;
+                while(pending.load(std::memory_order_acquire) != 0){
+                    if(workers_[i]->dq.pop(event) || try_steal(event)){
+                        body(event);
+                        pending.fetch_sub(1, std::memory_order_acq_rel);
+                        idle = 0;
+                    }else if(++idle > 64){
+                        std::this_thread::yield();
+                    }
+                }
+            }});
+        }
+        for(auto& t: threads){
+            t.join();
+        }
+    }
+};
+
+template<typename T>
+void quick_sort(std::vector<T>& arr, int start, int end, WorkStealingScheduler& sched){
+    while(true){
+        if(end - start <= network::small_sort_max){
+            network::small_sort(arr.data() + start, end - start);
+            return;
+        }
+        int i = start+1;
+        for(int j = i; j < end; j++){
+            if(arr[j] < arr[start]){
+                std::swap(arr[i], arr[j]);
+                i++;
+            }
+        }
+        int mid = i-1;
+        std::swap(arr[mid], arr[start]);
+        if((mid - start) > 10){
+            sched.spawn({start, mid});      // 放進自己的deque，沒人來偷的話等一下自己會pop回來做(cache還是熱的)
+        }else{
+            quick_sort(arr, start, mid, sched);
+        }
+        start = mid+1;
+    }
+}
+
+template<typename T>
+void work_stealing_sort(std::vector<T>& vec, int thread_num){
+    WorkStealingScheduler sched(thread_num);
+    sched.run({0, (int)vec.size()}, [&vec, &sched](Event event){
+        quick_sort(vec, event.from, event.to, sched);
+    });
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    int num = argc > 1 ? std::stoi(argv[1]) : 10000000;
+    std::cout << "Avaliable Threads: " << thread_num << ", elements: " << num << std::endl;
+
+    std::mt19937 mt{0};
+    std::vector<int> input(num);
+    for(auto& e: input) e = mt();
+    std::vector<int> expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    std::cout << "threads\tglobal queue (ms)\twork stealing (ms)" << std::endl;
+    for(int n = 1; ; n = std::min(n * 2, thread_num)){
+        std::vector<int> vec = input;
+        auto start = std::chrono::steady_clock::now();
+        global_queue_sort(vec, n);
+        auto end = std::chrono::steady_clock::now();
+        bool ok = (vec == expected);
+        auto global_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        vec = input;
+        start = std::chrono::steady_clock::now();
+        work_stealing_sort(vec, n);
+        end = std::chrono::steady_clock::now();
+        ok = ok && (vec == expected);
+        auto steal_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        std::cout << n << "\t" << global_ms << "\t\t\t" << steal_ms << (ok ? "" : "\t(WRONG RESULT)") << std::endl;
+        if(n >= thread_num) break;
+    }
+
+    return 0;
+}
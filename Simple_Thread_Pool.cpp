@@ -5,6 +5,10 @@
 #include <condition_variable>
 #include <vector>
 #include <thread>
+#include <algorithm>
+#include <type_traits>
+#include "Trace_Event.hpp"   // 定義ENABLE_TRACE時記錄Chrome trace events
+#include "Async_Logger.hpp"  // LOG()：不拿鎖、批次寫出的非同步logger
 
 using namespace std::literals;
 
@@ -16,13 +20,30 @@ class Queue{
     std::condition_variable cv;
 public:
     void Enqueue(T val){
+        TRACE_SCOPE("Enqueue");
         {
             std::lock_guard<std::mutex> lk(m);
-            dq_.push_back(val);
+            dq_.push_back(std::move(val));
         }
         cv.notify_one();               // 叫醒其中一個thread起來進mutex準備拿任務。
     }
+    template<typename Range>
+    void EnqueueBulk(Range&& vals){        // 一整批任務只搶一次mutex。傳入暫存的range時把元素move進來。
+        TRACE_SCOPE("EnqueueBulk");
+        std::size_t n = 0;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            for(auto& val: vals){
+                if constexpr(std::is_lvalue_reference_v<Range>) dq_.push_back(val);
+                else dq_.push_back(std::move(val));
+                n++;
+            }
+        }
+        if(n == 1) cv.notify_one();        // 每一批只決定一次要叫醒幾個thread。
+        else if(n > 1) cv.notify_all();
+    }
     bool WaitandDequeue(T& value){
+        TRACE_SCOPE("WaitandDequeue");
         std::unique_lock<std::mutex> uk(m);
         cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
         // * 使用wait時，每個thread要進來搶m這個mutex，只有一個能夠搶到並且接續做後面的判斷條件確認，
@@ -31,10 +52,22 @@ public:
         // * wait加上判斷條件可以避免 lost wakeup 或是 spurious wakeup。
         // * wait後面的判斷條件當return ture時，程式碼會接續運行。
         if(dq_.empty()) return false;  // 當程試來到這邊時，代表事情都做完了，退出拿任務的迴圈。
-        value = dq_.front();           // 分配任務給thread
+        value = std::move(dq_.front()); // 分配任務給thread
         dq_.pop_front();               // 移除任務
         return true;                   // 叫拿到任務的thread再處理完後記得再回來排隊拿任務。
     }
+    template<typename OutputIt>
+    std::size_t WaitAndDequeueUpTo(std::size_t n, OutputIt out){   // 一次最多拿n個任務，回傳0代表事情都做完了。
+        TRACE_SCOPE("WaitAndDequeueUpTo");
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        std::size_t k = std::min(n, dq_.size());
+        for(std::size_t i = 0; i < k; i++){
+            *out++ = std::move(dq_.front());
+            dq_.pop_front();
+        }
+        return k;
+    }
     void Close(){
         closed.store(true);
         cv.notify_all();               // 叫醒所有的thread。
@@ -46,32 +79,35 @@ struct Event{
     int to;
 };
 
+constexpr std::size_t dequeue_batch = 2;   // worker一次最多拿幾個工作 (WaitAndDequeueUpTo)。
+
 int main(){
 
     int thread_num = std::thread::hardware_concurrency();
     std::cout << "Avaliable Threads: " << thread_num << std::endl;
  
-    std::mutex mo;
     Queue<Event> Jobs;
     // 先把 workers (threads) 都叫過來。
     std::vector<std::thread> workers;
     for(int i = 0; i < thread_num; i++){
-        workers.push_back(std::thread{[&Jobs, &mo]{
-            Event event;   // launch一個空的event去Jobs.WaitandDequeue拿工作
-            while(Jobs.WaitandDequeue(event)){
-                std::this_thread::sleep_for(0.1s);   // Force to switch threads
-                std::lock_guard<std::mutex> lk(mo);  // 此處的lock以及mutex是為了保護std::cout output stream.
-                std::cout << "[" << std::this_thread::get_id() << "]";
-                std::cout << " from: " << event.from << " -> to: " << event.to << std::endl;
+        workers.push_back(std::thread{[&Jobs]{
+            TRACE_THREAD_NAME("worker");
+            Event events[dequeue_batch];   // 一次最多拿dequeue_batch個工作，只搶一次mutex
+            std::size_t n;
+            while((n = Jobs.WaitAndDequeueUpTo(dequeue_batch, events)) > 0){
+                for(std::size_t k = 0; k < n; k++){
+                    const Event& event = events[k];
+                    TRACE_SCOPE("event", "from", event.from, "to", event.to);
+                    std::this_thread::sleep_for(0.1s);   // Force to switch threads
+                    // 不再用mutex保護std::cout並且每一行都flush，而是格式化到自己的buffer後交給背景的writer批次寫出。
+                    LOG() << "[" << std::this_thread::get_id() << "] from: " << event.from << " -> to: " << event.to;
+                }
             }            
         }});
     } 
 
     // 再分配工作。
-    Jobs.Enqueue({10, 20});
-    Jobs.Enqueue({20, 30});
-    Jobs.Enqueue({30, 40});
-    Jobs.Enqueue({40, 50});
+    Jobs.EnqueueBulk(std::vector<Event>{{10, 20}, {20, 30}, {30, 40}, {40, 50}});   // 一次放入一整批，只搶一次mutex。
 
     // 最後再通知大家可以休息了。
     Jobs.Close();
@@ -0,0 +1,210 @@
+// 編譯參數： -std=c++20 -O2
+// 1. 目前的thread pool只能處理Event{from, to}這種固定格式的工作，要做成泛用的thread pool，
+//    一般會使用std::function<void()>或是std::packaged_task來包裝任意的callable物件，
+//    但它們在callable比較大時(libstdc++的std::function只有16 bytes的內部空間)
+//    每一個任務都要去heap配置一次記憶體(malloc)，任務很小的時候malloc的成本反而比任務本身還高。
+// 2. Task: 只能移動(move-only)、型別抹除(type-erased)的任務物件，並帶有small buffer optimization(SBO)。
+//    a. callable小於等於Capacity (預設48 bytes)且移動建構不會丟例外時，直接建構在Task內部的buffer中，
+//       完全不需要malloc；太大的callable才退回到heap上。
+//    b. 型別抹除的方式是每一種callable型別對應一個靜態的操作表(invoke / move / destroy)，
+//       Task本身只多存一個指標。
+//    c. Task只能移動不能複製，因此可以包裝std::packaged_task、std::unique_ptr這類move-only的物件。
+// 3. Queue<T>在Enqueue以及WaitandDequeue時改成移動(std::move)而不是複製。
+// 4. main為microbenchmark：比較Task與std::function每秒可以處理的任務數，以及各自呼叫operator new的次數。
+//    (Task剩下的配置次數來自std::deque本身的區塊(每個區塊放好幾個Task)，而不是Task本身。)
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <new>
+#include <chrono>
+#include <cstdlib>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+using namespace std::literals;
+
+// 統計operator new被呼叫的次數 (只為了benchmark)
+std::atomic<std::size_t> allocations{0};
+void* operator new(std::size_t sz){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(sz ? sz : 1)) return p;
+    throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+template<std::size_t Capacity = 48>
+class Task{
+    struct VTable{
+        void (*invoke)(void* self);
+        void (*move)(void* dst, void* src);     // 移動建構到dst並解構src
+        void (*destroy)(void* self);
+    };
+
+    template<typename F>
+    static constexpr bool fits_inline = sizeof(F) <= Capacity
+                                     && alignof(F) <= alignof(std::max_align_t)
+                                     && std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    static constexpr VTable inline_vtable{
+        [](void* self){ (*static_cast<F*>(self))(); },
+        [](void* dst, void* src){
+            ::new(dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        },
+        [](void* self){ static_cast<F*>(self)->~F(); }
+    };
+
+    template<typename F>
+    static constexpr VTable heap_vtable{        // buffer中只放一個F*
+        [](void* self){ (**static_cast<F**>(self))(); },
+        [](void* dst, void* src){ *static_cast<F**>(dst) = *static_cast<F**>(src); },
+        [](void* self){ delete *static_cast<F**>(self); }
+    };
+
+    alignas(std::max_align_t) unsigned char buf_[Capacity];
+    const VTable* vt_ = nullptr;
+
+public:
+    Task() = default;
+
+    template<typename F, typename D = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<D, Task> && std::is_invocable_v<D&>>>
+    Task(F&& f){
+        if constexpr(fits_inline<D>){
+            ::new(buf_) D(std::forward<F>(f));
+            vt_ = &inline_vtable<D>;
+        }else{
+            *reinterpret_cast<D**>(buf_) = new D(std::forward<F>(f));
+            vt_ = &heap_vtable<D>;
+        }
+    }
+
+    Task(Task&& other) noexcept : vt_(other.vt_){
+        if(vt_){
+            vt_->move(buf_, other.buf_);
+            other.vt_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept{
+        if(this != &other){
+            reset();
+            if(other.vt_){
+                other.vt_->move(buf_, other.buf_);
+                vt_ = other.vt_;
+                other.vt_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task(){ reset(); }
+
+    void reset(){
+        if(vt_){
+            vt_->destroy(buf_);
+            vt_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return vt_ != nullptr; }
+
+    void operator()(){ vt_->invoke(buf_); }
+};
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));     // 移動進佇列，不複製
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());        // 移動出佇列，不複製
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+// 把任務丟給thread_num個worker執行，回傳每秒處理的任務數。
+template<typename TaskType>
+double bench(int thread_num, int tasks){
+    Queue<TaskType> Jobs;
+    std::atomic<long long> sum{0};
+    std::vector<long long> data(4, 1);
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> workers;
+        for(int i = 0; i < thread_num; i++){
+            workers.emplace_back([&Jobs]{
+                TaskType task;
+                while(Jobs.WaitandDequeue(task)) task();
+            });
+        }
+        for(int i = 0; i < tasks; i++){
+            long long* p = data.data();
+            std::atomic<long long>* s = &sum;
+            long long a = i, b = 2 * i;
+            Jobs.Enqueue([p, s, a, b]{          // 32 bytes的capture：std::function放不下，Task放得下
+                s->fetch_add(p[0] + a + b, std::memory_order_relaxed);
+            });
+        }
+        Jobs.Close();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return tasks / std::chrono::duration<double>(end - start).count();
+}
+
+int main(){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+
+    // move-only的callable也可以放進Task
+    Task<> t{[p = std::make_unique<int>(42)]{ std::cout << "unique_ptr task: " << *p << std::endl; }};
+    Task<> moved = std::move(t);
+    moved();
+
+    constexpr int tasks = 1000000;
+    for(int n: {1, thread_num}){
+        std::size_t before = allocations.load();
+        double f = bench<std::function<void()>>(n, tasks);
+        std::size_t f_alloc = allocations.load() - before;
+
+        before = allocations.load();
+        double s = bench<Task<>>(n, tasks);
+        std::size_t s_alloc = allocations.load() - before;
+
+        std::cout << "workers: " << n << std::endl;
+        std::cout << "  std::function: " << f / 1e6 << " Mtasks/s, " << f_alloc << " allocations" << std::endl;
+        std::cout << "  Task<48>:      " << s / 1e6 << " Mtasks/s, " << s_alloc << " allocations" << std::endl;
+        if(n == thread_num) break;
+    }
+
+    return 0;
+}
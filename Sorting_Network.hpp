@@ -0,0 +1,111 @@
+// 小區間的排序：編譯時期產生的sorting network (-std=c++17以上)
+// 1. quick_sort一路遞迴到只剩一兩個元素，最後這幾層的呼叫次數最多，分支也最難預測。
+// 2. network::sort<N>(v)：排序v[0, N)。
+//    a. 比較器(comparator)的順序由Batcher's odd-even merge sort在編譯時期(constexpr)產生，
+//       N不是2的次方時以下一個2的次方產生，再去掉碰到[N, ..)的比較器(那些位置可以想成+inf，比較結果不會改變)。
+//    b. 以fold expression全部展開，每個索引都是常數，元素可以全部放在register中；
+//       compare_exchange以條件選擇(cmov/min/max)取代分支，彼此獨立的比較器也可以被編譯器向量化。
+//    c. 比較器的順序與資料無關，相等的元素可能交換位置，不是stable的。
+// 3. network::small_sort(first, n)：n <= max_size時使用對應大小的network；
+//    更長的區間(到small_sort_max)先以network排好前max_size個，剩下的再以insertion sort逐一插入。
+//    不是數值(arithmetic)型別時，複製的成本可能很高，直接使用insertion sort。
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+
+namespace network{
+
+constexpr int max_size = 16;          // 有network的最大長度
+constexpr int small_sort_max = 32;    // small_sort建議處理的最大長度 (排序演算法的leaf case)
+
+struct Comparator{
+    int a;
+    int b;
+};
+
+// Batcher's odd-even merge sort，對每個比較器(a < b)呼叫emit(a, b)
+template<typename F>
+constexpr void batcher(int n, F&& emit){
+    int size = 1;
+    while(size < n) size <<= 1;
+    for(int p = 1; p < size; p <<= 1){
+        for(int k = p; k >= 1; k >>= 1){
+            for(int j = k % p; j + k < size; j += 2 * k){
+                for(int i = 0; i < k && i < size - j - k; i++){
+                    if((i + j) / (2 * p) == (i + j + k) / (2 * p) && i + j + k < n) emit(i + j, i + j + k);
+                }
+            }
+        }
+    }
+}
+
+constexpr int comparator_count(int n){
+    int count = 0;
+    batcher(n, [&count](int, int){ count++; });
+    return count;
+}
+
+template<int N>
+struct Network{
+    static constexpr int size = comparator_count(N);
+    static constexpr std::array<Comparator, size> comparators = []{
+        std::array<Comparator, size> c{};
+        int k = 0;
+        batcher(N, [&c, &k](int a, int b){ c[k++] = {a, b}; });
+        return c;
+    }();
+};
+
+template<typename T>
+inline void compare_exchange(T& a, T& b){
+    bool swap = b < a;
+    T lo = swap ? b : a;
+    T hi = swap ? a : b;
+    a = lo;
+    b = hi;
+}
+
+template<int N, typename T, std::size_t... I>
+inline void apply([[maybe_unused]] T* v, std::index_sequence<I...>){   // N < 2時沒有comparator
+    (compare_exchange(v[Network<N>::comparators[I].a], v[Network<N>::comparators[I].b]), ...);
+}
+
+template<int N, typename T>
+inline void sort(T* v){
+    apply<N>(v, std::make_index_sequence<Network<N>::size>{});
+}
+
+template<typename T, std::size_t... N>
+inline void sort_dispatch(T* v, int n, std::index_sequence<N...>){
+    using Fn = void (*)(T*);
+    static constexpr Fn table[] = {&sort<(int)N, T>...};
+    table[n](v);
+}
+
+template<typename T>
+inline void insertion_sort(T* first, int from, int n){   // first[0, from)已經排好
+    for(int i = from; i < n; i++){
+        T v = std::move(first[i]);
+        int j = i;
+        for(; j > 0 && v < first[j - 1]; j--){
+            first[j] = std::move(first[j - 1]);
+        }
+        first[j] = std::move(v);
+    }
+}
+
+template<typename T>
+inline void small_sort(T* first, int n){
+    if constexpr(std::is_arithmetic_v<T>){
+        int k = std::min(n, max_size);
+        sort_dispatch(first, k, std::make_index_sequence<max_size + 1>{});
+        insertion_sort(first, k, n);
+    }else{
+        insertion_sort(first, 1, n);
+    }
+}
+
+}  // namespace network
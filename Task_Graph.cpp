@@ -0,0 +1,305 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Course Notes/thread_synchronization/hw4_sol.cpp用三條專用的執行緒、condition_variable以及一堆bool旗標
+//    (update_progress、data_to_process、completed)把 fetch -> progress -> process 的流程串起來，
+//    流程只要一改就要重新想一次誰要等誰、誰要叫醒誰。
+// 2. TaskGraph：先宣告節點(emplace)以及相依關係(precede，a -> b 代表a做完b才能開始)，之後可以在pool上重複執行(run)。
+//    a. 第一次run時(或圖被修改過以後)計算每個節點的in-degree以及沒有前置節點的root，並檢查是否有環(cycle)。
+//    b. 每個節點有一個atomic的相依計數器(pending)，每次run開始時重設成in-degree。
+//    c. 沒有中央的排程執行緒(scheduler thread)：做完一個節點的worker自己把後繼節點的計數器減一，
+//       減到0的後繼節點中，第一個直接在同一條worker上接著做(不用再經過佇列)，其他的丟回pool。
+//    d. 所有節點都做完時(remaining減到0)，在持有mutex的情況下通知run的呼叫端，
+//       確保呼叫端返回(甚至把graph解構)以後，worker不會再碰到graph的任何成員。
+//    e. 同一個TaskGraph一次只能有一個run在執行。
+// 3. main：
+//    a. 以TaskGraph重新表達hw4_sol.cpp的流程(5個block)，並且執行兩次。
+//    b. benchmark：10k個節點(100層 × 100個，每個節點相依於上一層的2個節點)的空任務，
+//       量測每次run的時間以及每個節點的額外負擔，並和「一層一層用latch等待」的做法比較。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <latch>
+#include <chrono>
+#include <random>
+#include <string>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std::literals;
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+class ThreadPool{
+    Queue<std::function<void()>> Jobs;
+    std::vector<std::thread> workers;
+public:
+    explicit ThreadPool(int thread_num){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this]{
+                std::function<void()> task;
+                while(Jobs.WaitandDequeue(task)){
+                    task();
+                }
+            }});
+        }
+    }
+    ~ThreadPool(){
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+
+    template<typename F>
+    void post(F&& f){ Jobs.Enqueue(std::forward<F>(f)); }
+};
+
+class TaskGraph{
+public:
+    using NodeId = std::size_t;
+
+    template<typename F>
+    NodeId emplace(F&& f){
+        nodes_.push_back({std::forward<F>(f), {}, 0});
+        dirty_ = true;
+        return nodes_.size() - 1;
+    }
+
+    // a做完以後b才能開始
+    void precede(NodeId a, NodeId b){
+        nodes_[a].succ.push_back(b);
+        dirty_ = true;
+    }
+
+    std::size_t size() const { return nodes_.size(); }
+
+    // 在pool上執行整張圖，全部做完才返回。
+    void run(ThreadPool& pool){
+        if(dirty_) prepare();
+        if(nodes_.empty()) return;
+        for(std::size_t i = 0; i < nodes_.size(); i++){
+            pending_[i].store(nodes_[i].indegree, std::memory_order_relaxed);
+        }
+        remaining_.store(nodes_.size(), std::memory_order_relaxed);
+        done_ = false;
+        pool_ = &pool;
+        for(auto r: roots_){                              // Enqueue中的mutex讓上面的初始化對worker可見
+            pool.post([this, r]{ execute(r); });
+        }
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{ return done_; });
+    }
+
+private:
+    static constexpr NodeId none = std::numeric_limits<NodeId>::max();
+
+    struct Node{
+        std::function<void()> work;
+        std::vector<NodeId> succ;
+        int indegree;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<NodeId> roots_;
+    std::unique_ptr<std::atomic<int>[]> pending_;        // 每個節點還有幾個前置節點沒做完
+    std::atomic<std::size_t> remaining_{0};              // 這次run還有幾個節點沒做完
+    ThreadPool* pool_ = nullptr;
+    bool dirty_ = true;
+    bool done_ = false;
+    std::mutex m;
+    std::condition_variable cv;
+
+    // 計算in-degree以及root，並以Kahn's algorithm確認沒有環。
+    void prepare(){
+        for(auto& n: nodes_) n.indegree = 0;
+        for(auto& n: nodes_){
+            for(auto s: n.succ) nodes_[s].indegree++;
+        }
+        roots_.clear();
+        std::vector<int> indeg(nodes_.size());
+        std::vector<NodeId> ready;
+        for(NodeId i = 0; i < nodes_.size(); i++){
+            indeg[i] = nodes_[i].indegree;
+            if(indeg[i] == 0){
+                roots_.push_back(i);
+                ready.push_back(i);
+            }
+        }
+        std::size_t visited = 0;
+        while(!ready.empty()){
+            NodeId id = ready.back();
+            ready.pop_back();
+            visited++;
+            for(auto s: nodes_[id].succ){
+                if(--indeg[s] == 0) ready.push_back(s);
+            }
+        }
+        if(visited != nodes_.size()){
+            throw std::invalid_argument("TaskGraph contains a cycle");
+        }
+        pending_.reset(new std::atomic<int>[nodes_.size()]);
+        dirty_ = false;
+    }
+
+    void execute(NodeId id){
+        while(true){
+            nodes_[id].work();
+            NodeId next = none;
+            for(auto s: nodes_[id].succ){
+                if(pending_[s].fetch_sub(1, std::memory_order_acq_rel) == 1){
+                    if(next == none) next = s;            // 第一個可以開始的後繼節點留給自己做
+                    else pool_->post([this, s]{ execute(s); });
+                }
+            }
+            if(remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1){
+                std::lock_guard<std::mutex> lk(m);        // 持有mutex時通知：呼叫端返回以後不會再碰到graph
+                done_ = true;
+                cv.notify_all();
+                return;
+            }
+            if(next == none) return;
+            id = next;
+        }
+    }
+};
+
+// 與hw4_sol.cpp相同的流程：每個block先fetch，fetch做完以後progress以及process才能開始；
+// fetch、progress、process各自依照block的順序執行。所有的等待都由圖的邊表達，不需要任何旗標。
+void hw4_flow(ThreadPool& pool){
+    constexpr int blocks = 5;
+    std::mutex mo;                                        // 保護std::cout
+    std::vector<std::string> sdata(blocks, "Empty");
+    std::size_t len = 0;
+    auto say = [&mo](const std::string& s){
+        std::lock_guard<std::mutex> lk(mo);
+        std::cout << s << std::endl;
+    };
+
+    TaskGraph g;
+    std::vector<TaskGraph::NodeId> fetch(blocks), progress(blocks), process(blocks);
+    for(int i = 0; i < blocks; i++){
+        fetch[i] = g.emplace([&, i]{
+            std::this_thread::sleep_for(100ms);           // Pretend to be busy...
+            sdata[i] = "Block " + std::to_string(i + 1);
+            say("Fetched sdata: " + sdata[i]);
+        });
+        progress[i] = g.emplace([&, i]{
+            len += sdata[i].size();
+            say("Received " + std::to_string(len) + " bytes so far");
+        });
+        process[i] = g.emplace([&, i]{
+            say("Processing sdata: " + sdata[i]);
+        });
+        g.precede(fetch[i], progress[i]);
+        g.precede(fetch[i], process[i]);
+        if(i > 0){
+            g.precede(fetch[i - 1], fetch[i]);
+            g.precede(progress[i - 1], progress[i]);      // len依照順序累加
+            g.precede(process[i - 1], process[i]);
+        }
+    }
+    auto fetch_end = g.emplace([&]{ say("Fetch sdata has ended"); });
+    auto progress_end = g.emplace([&]{ say("Progress bar has ended"); });
+    auto process_end = g.emplace([&]{ say("sdata processing has ended"); });
+    g.precede(fetch[blocks - 1], fetch_end);
+    g.precede(progress[blocks - 1], progress_end);
+    g.precede(process[blocks - 1], process_end);
+
+    for(int run = 1; run <= 2; run++){                    // 宣告一次，執行多次
+        say("--- run " + std::to_string(run) + " ---");
+        len = 0;
+        g.run(pool);
+    }
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+    ThreadPool pool(thread_num);
+
+    hw4_flow(pool);
+
+    // Benchmark：layers × width個節點，每個節點相依於上一層隨機的2個節點。
+    int layers = 100, width = argc > 1 ? std::stoi(argv[1]) / layers : 100;
+    int runs = 50;
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<int> pick(0, width - 1);
+    std::vector<std::atomic<int>> counter(width);
+
+    TaskGraph g;
+    std::vector<std::vector<TaskGraph::NodeId>> ids(layers, std::vector<TaskGraph::NodeId>(width));
+    for(int l = 0; l < layers; l++){
+        for(int w = 0; w < width; w++){
+            ids[l][w] = g.emplace([&counter, w]{ counter[w].fetch_add(1, std::memory_order_relaxed); });
+            if(l > 0){
+                g.precede(ids[l - 1][pick(gen)], ids[l][w]);
+                g.precede(ids[l - 1][pick(gen)], ids[l][w]);
+            }
+        }
+    }
+    g.run(pool);                                          // 第一次run包含prepare，不列入計時
+
+    auto start = std::chrono::steady_clock::now();
+    for(int r = 0; r < runs; r++) g.run(pool);
+    auto end = std::chrono::steady_clock::now();
+    double graph_us = std::chrono::duration<double, std::micro>(end - start).count() / runs;
+
+    // 比較：每一層的節點各自丟進pool，用latch等整層做完才開始下一層 (level-synchronous)。
+    start = std::chrono::steady_clock::now();
+    for(int r = 0; r < runs; r++){
+        for(int l = 0; l < layers; l++){
+            std::latch done(width);
+            for(int w = 0; w < width; w++){
+                pool.post([&counter, &done, w]{
+                    counter[w].fetch_add(1, std::memory_order_relaxed);
+                    done.count_down();
+                });
+            }
+            done.wait();
+        }
+    }
+    end = std::chrono::steady_clock::now();
+    double level_us = std::chrono::duration<double, std::micro>(end - start).count() / runs;
+
+    int total = 0;
+    for(auto& c: counter) total += c.load();
+    std::size_t n = g.size();
+    std::cout << n << "-node graph (" << layers << " layers x " << width << "), " << runs << " runs, "
+              << "tasks executed: " << total << std::endl;
+    std::cout << "  task graph:        " << graph_us << " us per run, " << graph_us * 1000 / n << " ns per node" << std::endl;
+    std::cout << "  level-synchronous: " << level_us << " us per run, " << level_us * 1000 / n << " ns per node" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,408 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Quick_Sort_with_Simple_Thread_Pool.cpp以及Course Notes/Parallelism/quick_sort.cpp原本都是用一個共用的
+//    std::atomic<int> ct (remains) 來判斷工作是否全部做完 (現在改成每條執行緒自己的計數器，等待時再加總)：
+//    a. 每一次Enqueue/Dequeue都要對同一個atomic做++/--，所有的核心都在搶同一條cache line。
+//    b. main在 while(ct!=0) std::this_thread::yield(); 空轉(busy waiting)，白白佔用一個核心。
+// 2. TaskGroup: run(f)把任務交給thread pool，wait()等待這個group(以及它衍生出來的所有子任務)全部做完。
+//    a. 完成與否使用「join counter樹」來記錄：每個任務有自己的計數器(自己 + 還沒做完的子任務數)，
+//       在任務中呼叫run()產生的子任務掛在目前任務的計數器底下，計數器歸零時才去減父節點的計數器。
+//       因此只有兄弟任務之間會共用同一個計數器，不會全部擠在一個全域的atomic上。
+//    b. wait()的執行緒不會空轉，而是從pool的佇列中拿還沒做的任務來幫忙做(help while waiting)，
+//       佇列空了就和worker一樣睡在佇列的condition variable上(條件：有任務 || group已經做完)，
+//       有新的任務進來時醒來繼續幫忙，最後一個完成的任務也會叫醒它。
+// 3. main為benchmark：比較原本「全域計數器 + busy waiting」的版本以及TaskGroup版本的quick_sort，
+//    並統計wait()的執行緒幫忙做了多少任務。
+//    兩種quick_sort的leaf case相同(32個元素以下使用network::small_sort)，差異只在完成計數的方式。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "Sorting_Network.hpp"
+
+using namespace std::literals;
+
+// 與Small_Buffer_Task.cpp相同
+template<std::size_t Capacity = 48>
+class Task{
+    struct VTable{
+        void (*invoke)(void* self);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* self);
+    };
+
+    template<typename F>
+    static constexpr bool fits_inline = sizeof(F) <= Capacity
+                                     && alignof(F) <= alignof(std::max_align_t)
+                                     && std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    static constexpr VTable inline_vtable{
+        [](void* self){ (*static_cast<F*>(self))(); },
+        [](void* dst, void* src){
+            ::new(dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        },
+        [](void* self){ static_cast<F*>(self)->~F(); }
+    };
+
+    template<typename F>
+    static constexpr VTable heap_vtable{
+        [](void* self){ (**static_cast<F**>(self))(); },
+        [](void* dst, void* src){ *static_cast<F**>(dst) = *static_cast<F**>(src); },
+        [](void* self){ delete *static_cast<F**>(self); }
+    };
+
+    alignas(std::max_align_t) unsigned char buf_[Capacity];
+    const VTable* vt_ = nullptr;
+
+public:
+    Task() = default;
+
+    template<typename F, typename D = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<D, Task> && std::is_invocable_v<D&>>>
+    Task(F&& f){
+        if constexpr(fits_inline<D>){
+            ::new(buf_) D(std::forward<F>(f));
+            vt_ = &inline_vtable<D>;
+        }else{
+            *reinterpret_cast<D**>(buf_) = new D(std::forward<F>(f));
+            vt_ = &heap_vtable<D>;
+        }
+    }
+
+    Task(Task&& other) noexcept : vt_(other.vt_){
+        if(vt_){
+            vt_->move(buf_, other.buf_);
+            other.vt_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept{
+        if(this != &other){
+            reset();
+            if(other.vt_){
+                other.vt_->move(buf_, other.buf_);
+                vt_ = other.vt_;
+                other.vt_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task(){ reset(); }
+
+    void reset(){
+        if(vt_){
+            vt_->destroy(buf_);
+            vt_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return vt_ != nullptr; }
+
+    void operator()(){ vt_->invoke(buf_); }
+};
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    // 等到佇列中有任務或是done()為true；done()為true時回傳false，不拿任務。
+    template<typename Pred>
+    bool WaitandDequeueUnless(T& value, Pred done){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [&]{return (done()||!dq_.empty());});
+        if(done()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    // done()的結果改變以後呼叫：先拿一次m，WaitandDequeueUnless檢查完條件、還沒睡著的執行緒不會漏掉。
+    void Notify(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+        }
+        cv.notify_all();
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+class ThreadPool{
+    Queue<Task<64>> Jobs;
+    std::vector<std::thread> workers;
+public:
+    explicit ThreadPool(int thread_num = std::thread::hardware_concurrency()){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this]{
+                Task<64> task;
+                while(Jobs.WaitandDequeue(task)){
+                    task();
+                    task.reset();
+                }
+            }});
+        }
+    }
+    ~ThreadPool(){
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<typename F>
+    void post(F&& f){ Jobs.Enqueue(Task<64>{std::forward<F>(f)}); }
+
+    // 幫忙執行還沒有人拿的任務，佇列空的時候睡在佇列的condition variable上，
+    // 有新的任務(Enqueue)或是done()變成true(wake_helpers)時醒來；done()為true時回傳false。
+    template<typename Pred>
+    bool run_pending_unless(Pred done){
+        Task<64> task;
+        if(!Jobs.WaitandDequeueUnless(task, done)) return false;
+        task();
+        return true;
+    }
+    void wake_helpers(){ Jobs.Notify(); }
+};
+
+class TaskGroup{
+    // join counter樹的節點：count = 自己(任務本身還在執行時為1) + 還沒完成的子任務數量
+    struct alignas(64) Node{
+        std::atomic<int> count{0};
+        Node* parent = nullptr;
+        Node* next_free = nullptr;
+    };
+
+    // 節點的free list (每個執行緒一份)，避免每個任務都要new/delete。
+    struct NodePool{
+        Node* head = nullptr;
+        ~NodePool(){
+            while(head){
+                Node* next = head->next_free;
+                delete head;
+                head = next;
+            }
+        }
+        Node* get(){
+            if(!head) return new Node;
+            Node* n = head;
+            head = n->next_free;
+            return n;
+        }
+        void put(Node* n){
+            n->next_free = head;
+            head = n;
+        }
+    };
+    static thread_local NodePool node_pool;
+
+    // 目前執行緒正在執行哪個group的哪個節點 (在任務中呼叫run()時，子任務要掛在這個節點底下)
+    struct Current{
+        TaskGroup* group = nullptr;
+        Node* node = nullptr;
+    };
+    static thread_local Current current;
+
+    ThreadPool& pool_;
+    Node root_;                                 // root_.count = 還沒完成的直接子任務數量
+    std::atomic<long long> helped{0};
+
+    void finish(Node* node){
+        while(node != &root_){
+            if(node->count.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            Node* parent = node->parent;
+            node_pool.put(node);
+            node = parent;
+        }
+        ThreadPool& pool = pool_;               // 歸零以後wait()可能立刻返回並解構這個group
+        if(root_.count.fetch_sub(1, std::memory_order_acq_rel) == 1){
+            pool.wake_helpers();                // 最後一個任務完成，叫醒wait()
+        }
+    }
+
+public:
+    explicit TaskGroup(ThreadPool& pool): pool_(pool){}
+    ~TaskGroup(){ wait(); }
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template<typename F>
+    void run(F&& f){
+        Node* parent = (current.group == this) ? current.node : &root_;
+        parent->count.fetch_add(1, std::memory_order_relaxed);
+        Node* node = node_pool.get();
+        node->count.store(1, std::memory_order_relaxed);
+        node->parent = parent;
+        pool_.post([this, node, f = std::forward<F>(f)]() mutable{
+            Current saved = current;
+            current = {this, node};
+            f();
+            current = saved;
+            finish(node);
+        });
+    }
+
+    void wait(){
+        auto done = [this]{ return root_.count.load(std::memory_order_acquire) == 0; };
+        while(pool_.run_pending_unless(done)){  // help while waiting
+            helped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    long long tasks_helped() const { return helped.load(); }
+};
+
+thread_local TaskGroup::NodePool TaskGroup::node_pool;
+thread_local TaskGroup::Current TaskGroup::current;
+
+/* -------------------- Global counter version (Quick_Sort_with_Simple_Thread_Pool.cpp) -------------------- */
+struct Event{
+    int from;
+    int to;
+};
+
+template<typename T>
+void quick_sort(std::vector<T>& arr, int start, int end, Queue<Event>& Jobs, std::atomic<int>& ct){
+    while(true){
+        if(end - start <= network::small_sort_max){      // 小區間交給sorting network (Sorting_Network.hpp)
+            network::small_sort(arr.data() + start, end - start);
+            return;
+        }
+        int i = start+1;
+        for(int j = i; j < end; j++){
+            if(arr[j] < arr[start]){
+                std::swap(arr[i], arr[j]);
+                i++;
+            }
+        }
+        int mid = i-1;
+        std::swap(arr[mid], arr[start]);
+        if((mid - start) > 10){
+            ct++;
+            Jobs.Enqueue({start, mid});
+        }else{
+            quick_sort(arr, start, mid, Jobs, ct);
+        }
+        start = mid+1;
+    }
+}
+
+template<typename T>
+void counter_sort(std::vector<T>& vec, int thread_num){
+    std::atomic<int> ct{1};
+    Queue<Event> Jobs;
+    Jobs.Enqueue({0, (int)vec.size()});
+    std::vector<std::thread> workers;
+    for(int i = 0; i < thread_num; i++){
+        workers.push_back(std::thread{[&Jobs, &vec, &ct]{
+            Event event;
+            while(Jobs.WaitandDequeue(event)){
+                quick_sort(vec, event.from, event.to, Jobs, ct);
+                ct--;
+            }
+        }});
+    }
+    while(ct!=0){
+        std::this_thread::yield();
+    }
+    Jobs.Close();
+    for(auto& t: workers){
+        t.join();
+    }
+}
+
+/* -------------------- TaskGroup version -------------------- */
+template<typename T>
+void quick_sort(std::vector<T>& arr, int start, int end, TaskGroup& tg){
+    while(true){
+        if(end - start <= network::small_sort_max){
+            network::small_sort(arr.data() + start, end - start);
+            return;
+        }
+        int i = start+1;
+        for(int j = i; j < end; j++){
+            if(arr[j] < arr[start]){
+                std::swap(arr[i], arr[j]);
+                i++;
+            }
+        }
+        int mid = i-1;
+        std::swap(arr[mid], arr[start]);
+        if((mid - start) > 10){
+            tg.run([&arr, start, mid, &tg]{ quick_sort(arr, start, mid, tg); });
+        }else{
+            quick_sort(arr, start, mid, tg);
+        }
+        start = mid+1;
+    }
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    int num = argc > 1 ? std::stoi(argv[1]) : 5000000;
+    std::cout << "Avaliable Threads: " << thread_num << ", elements: " << num << std::endl;
+
+    std::mt19937 mt{0};
+    std::vector<int> input(num);
+    for(auto& e: input) e = mt();
+    std::vector<int> expected = input;
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<int> vec = input;
+    auto start = std::chrono::steady_clock::now();
+    counter_sort(vec, thread_num);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "global counter + busy wait: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms"
+              << (vec == expected ? "" : " (WRONG RESULT)") << std::endl;
+
+    vec = input;
+    ThreadPool pool(thread_num);
+    start = std::chrono::steady_clock::now();
+    TaskGroup tg(pool);
+    tg.run([&vec, &tg]{ quick_sort(vec, 0, (int)vec.size(), tg); });
+    tg.wait();
+    end = std::chrono::steady_clock::now();
+    std::cout << "TaskGroup (help while waiting): "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms"
+              << (vec == expected ? "" : " (WRONG RESULT)")
+              << ", tasks run by the waiting thread: " << tg.tasks_helped() << std::endl;
+
+    return 0;
+}
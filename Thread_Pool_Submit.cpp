@@ -0,0 +1,420 @@
+// 編譯參數： -std=c++20 -O2
+// 1. Vector_Map_Reduce_with_Tasks.cpp中的async_res使用std::async(std::launch::async, ...)，
+//    packaged_task_res則是每一個std::packaged_task都開一個detach的std::thread，
+//    也就是每一個chunk都要開一條新的執行緒(成本很高)，而且每次呼叫都要配置一個新的shared state。
+// 2. ThreadPool::submit(f, args...)：把任務交給Simple_Thread_Pool.cpp那樣固定數量的worker執行，
+//    並回傳一個類似std::future的Future<R>。
+//    a. 任務以Task (見Small_Buffer_Task.cpp)包裝，f以及args直接存在Task的inline buffer中，不需要malloc。
+//    b. Future與worker之間共用的SharedState<R>由Future這一端負責回收：worker寫完結果並放手以後，
+//       Future (get()或解構時)把它放回目前執行緒「自己的」free list (thread_local)，
+//       下一次submit時直接拿出來重複使用，因此穩定狀態下submit完全不會配置記憶體。
+//    c. get()先自旋一小段時間，再使用C++20的atomic wait睡覺(由set的一方notify)。
+//    d. 任務丟出的例外會被存到SharedState中，並在get()時重新丟出(與std::future相同)。
+// 3. async_res以及packaged_task_res改寫成使用pool.submit，不再為每一個chunk開新的執行緒。
+// 4. main與Vector_Map_Reduce_with_Tasks.cpp相同的測試，另外比較std::async與pool.submit處理大量小chunk的時間。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <future>
+#include <numeric>
+#include <random>
+#include <cmath>
+#include <chrono>
+#include <tuple>
+#include <exception>
+#include <optional>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+using namespace std::literals;
+
+// 與Small_Buffer_Task.cpp相同
+template<std::size_t Capacity = 48>
+class Task{
+    struct VTable{
+        void (*invoke)(void* self);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* self);
+    };
+
+    template<typename F>
+    static constexpr bool fits_inline = sizeof(F) <= Capacity
+                                     && alignof(F) <= alignof(std::max_align_t)
+                                     && std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    static constexpr VTable inline_vtable{
+        [](void* self){ (*static_cast<F*>(self))(); },
+        [](void* dst, void* src){
+            ::new(dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        },
+        [](void* self){ static_cast<F*>(self)->~F(); }
+    };
+
+    template<typename F>
+    static constexpr VTable heap_vtable{
+        [](void* self){ (**static_cast<F**>(self))(); },
+        [](void* dst, void* src){ *static_cast<F**>(dst) = *static_cast<F**>(src); },
+        [](void* self){ delete *static_cast<F**>(self); }
+    };
+
+    alignas(std::max_align_t) unsigned char buf_[Capacity];
+    const VTable* vt_ = nullptr;
+
+public:
+    Task() = default;
+
+    template<typename F, typename D = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<D, Task> && std::is_invocable_v<D&>>>
+    Task(F&& f){
+        if constexpr(fits_inline<D>){
+            ::new(buf_) D(std::forward<F>(f));
+            vt_ = &inline_vtable<D>;
+        }else{
+            *reinterpret_cast<D**>(buf_) = new D(std::forward<F>(f));
+            vt_ = &heap_vtable<D>;
+        }
+    }
+
+    Task(Task&& other) noexcept : vt_(other.vt_){
+        if(vt_){
+            vt_->move(buf_, other.buf_);
+            other.vt_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept{
+        if(this != &other){
+            reset();
+            if(other.vt_){
+                other.vt_->move(buf_, other.buf_);
+                vt_ = other.vt_;
+                other.vt_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task(){ reset(); }
+
+    void reset(){
+        if(vt_){
+            vt_->destroy(buf_);
+            vt_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return vt_ != nullptr; }
+
+    void operator()(){ vt_->invoke(buf_); }
+};
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+template<typename R>
+struct SharedState{
+    using Storage = std::conditional_t<std::is_void_v<R>, char, R>;
+    enum : int { pending = 0, ready = 1, finished = 2 };
+    std::atomic<int> status{pending};      // finished代表worker已經不會再碰這個shared state
+    std::optional<Storage> value;
+    std::exception_ptr error;
+    SharedState* next_free = nullptr;
+
+    // 每個執行緒自己的free list，只有自己會存取，不需要任何同步。
+    struct FreeList{
+        SharedState* head = nullptr;
+        std::size_t size = 0;
+        std::size_t misses = 0;             // 真的去heap配置的次數
+        ~FreeList(){
+            while(head){
+                SharedState* next = head->next_free;
+                delete head;
+                head = next;
+            }
+        }
+    };
+    static constexpr std::size_t max_free = 1024;
+    static inline thread_local FreeList free_list;
+
+    static SharedState* acquire(){
+        FreeList& fl = free_list;
+        if(fl.head){
+            SharedState* s = fl.head;
+            fl.head = s->next_free;
+            fl.size--;
+            s->status.store(pending, std::memory_order_relaxed);
+            return s;
+        }
+        fl.misses++;
+        return new SharedState;
+    }
+
+    // worker端：結果寫好以後呼叫，之後worker就不會再碰這個shared state。
+    void set_ready(){
+        status.store(ready, std::memory_order_release);
+        status.notify_one();
+        status.store(finished, std::memory_order_release);
+    }
+
+    // Future端：等到worker完全放手以後，放回目前執行緒(通常就是submit的那個執行緒)的free list。
+    void recycle(){
+        int st;
+        while((st = status.load(std::memory_order_acquire)) != finished){
+            if(st == pending) status.wait(pending, std::memory_order_acquire);
+            else std::this_thread::yield();     // ready -> finished之間只有幾個指令
+        }
+        value.reset();
+        error = nullptr;
+        FreeList& fl = free_list;
+        if(fl.size >= max_free){
+            delete this;
+            return;
+        }
+        next_free = fl.head;
+        fl.head = this;
+        fl.size++;
+    }
+};
+
+// 與std::async回傳的std::future相同，沒有get()就解構時會等待任務完成。
+template<typename R>
+class Future{
+    SharedState<R>* state_ = nullptr;
+public:
+    Future() = default;
+    explicit Future(SharedState<R>* s): state_(s){}
+    Future(Future&& other) noexcept : state_(std::exchange(other.state_, nullptr)){}
+    Future& operator=(Future&& other) noexcept{
+        if(this != &other){
+            if(state_) state_->recycle();
+            state_ = std::exchange(other.state_, nullptr);
+        }
+        return *this;
+    }
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+    ~Future(){ if(state_) state_->recycle(); }
+
+    bool valid() const { return state_ != nullptr; }
+
+    bool is_ready() const { return state_->status.load(std::memory_order_acquire) != SharedState<R>::pending; }
+
+    void wait() const{
+        for(int i = 0; i < 128; i++){
+            if(is_ready()) return;
+        }
+        while(!is_ready()){
+            state_->status.wait(SharedState<R>::pending, std::memory_order_acquire);
+        }
+    }
+
+    // 與std::future相同，get()只能呼叫一次。
+    R get(){
+        wait();
+        SharedState<R>* s = std::exchange(state_, nullptr);
+        struct Recycle{ SharedState<R>* s; ~Recycle(){ s->recycle(); } } guard{s};
+        if(s->error) std::rethrow_exception(s->error);
+        if constexpr(!std::is_void_v<R>){
+            return std::move(*s->value);
+        }
+    }
+};
+
+class ThreadPool{
+    Queue<Task<64>> Jobs;
+    std::vector<std::thread> workers;
+public:
+    explicit ThreadPool(int thread_num = std::thread::hardware_concurrency()){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this]{
+                Task<64> task;
+                while(Jobs.WaitandDequeue(task)){
+                    task();
+                    task.reset();
+                }
+            }});
+        }
+    }
+    ~ThreadPool(){
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return workers.size(); }
+
+    template<typename F, typename... Args>
+    auto submit(F&& f, Args&&... args){
+        using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        SharedState<R>* s = SharedState<R>::acquire();
+        Jobs.Enqueue([s, f = std::forward<F>(f), tup = std::make_tuple(std::forward<Args>(args)...)]() mutable{
+            try{
+                if constexpr(std::is_void_v<R>){
+                    std::apply(f, std::move(tup));
+                }else{
+                    s->value.emplace(std::apply(f, std::move(tup)));
+                }
+            }catch(...){
+                s->error = std::current_exception();
+            }
+            s->set_ready();
+        });
+        return Future<R>{s};
+    }
+};
+
+template<typename T>
+T accum(T *beg, T *end, T init) {
+    return std::accumulate(beg, end, init);
+}
+
+// 原本: 每一個chunk使用 std::async(std::launch::async, ...) 開一條新的執行緒。
+template<typename T>
+T async_res(std::vector<T>& data, const int& thread_num, ThreadPool& pool) {
+    int vec_size = data.size();
+    int range_ = std::ceil((double) data.size() / (double) thread_num);
+    std::vector<Future<T>> Results;
+    for(int i = 0; i < thread_num; i++){
+        Results.push_back(pool.submit(
+            accum<T>,
+            data.data() + std::min(i*range_, vec_size),
+            data.data() + std::min((i+1)*range_, vec_size),
+            T{0}
+        ));
+    }
+    T sum = 0;
+    for(auto& res: Results){
+        sum += res.get();
+    }
+    return sum;
+}
+
+// 原本: 每一個std::packaged_task交給一條detach的std::thread。
+template<typename T>
+T packaged_task_res(std::vector<T>& data, const int& thread_num, ThreadPool& pool) {
+    int vec_size = data.size();
+    int range_ = std::ceil((double) data.size() / (double) thread_num);
+    std::vector<Future<T>> Results;
+    for(int i = 0; i < thread_num; i++){
+        // a. Wrap the task + b. Create the future + c. Perform the calculation (on the pool).
+        Results.push_back(pool.submit([beg = data.data() + std::min(i*range_, vec_size),
+                                       end = data.data() + std::min((i+1)*range_, vec_size)]{
+            return accum<T>(beg, end, 0);
+        }));
+    }
+    T sum = 0;
+    // d. Pick up the result.
+    for(auto& res: Results){
+        sum += res.get();
+    }
+    return sum;
+}
+
+int main(){
+    ThreadPool pool;
+    std::cout << "Pool workers: " << pool.size() << std::endl;
+
+    // Vector Data Initialization
+    int vec_sz{10000};
+    std::vector<double> vec(vec_sz);
+    std::mt19937 mt{};
+    for(int i = 0; i < vec_sz; i++){
+        vec[i] = mt();
+    }
+
+    // Test Data Initialization
+    std::vector<int> test_vec{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+    // Test Cases
+    std::cout << async_res(test_vec, 4, pool) << std::endl;
+    std::cout << "====================================" << std::endl;
+    std::cout << packaged_task_res(test_vec, 4, pool) << std::endl;
+    std::cout << "====================================" << std::endl;
+    std::cout << async_res(vec, 4, pool) << std::endl;
+    std::cout << "====================================" << std::endl;
+    std::cout << packaged_task_res(vec, 4, pool) << std::endl;
+    std::cout << "====================================" << std::endl;
+
+    // Exception propagation
+    auto bad = pool.submit([]() -> int { throw std::runtime_error("task failed"); });
+    try{
+        bad.get();
+    }catch(const std::exception& e){
+        std::cout << "exception from pool: " << e.what() << std::endl;
+    }
+
+    // Benchmark: 大量的小chunk
+    constexpr int rounds = 2000, chunks = 16;
+    auto start = std::chrono::steady_clock::now();
+    double s1 = 0;
+    for(int r = 0; r < rounds; r++){
+        std::vector<std::future<double>> fs;
+        for(int c = 0; c < chunks; c++){
+            fs.push_back(std::async(std::launch::async, accum<double>, &vec[c * 16], &vec[c * 16 + 16], 0.0));
+        }
+        for(auto& f: fs) s1 += f.get();
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto async_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    std::size_t misses_before = SharedState<double>::free_list.misses;
+    start = std::chrono::steady_clock::now();
+    double s2 = 0;
+    std::vector<Future<double>> fs;
+    for(int r = 0; r < rounds; r++){
+        fs.clear();
+        for(int c = 0; c < chunks; c++){
+            fs.push_back(pool.submit(accum<double>, &vec[c * 16], &vec[c * 16 + 16], 0.0));
+        }
+        for(auto& f: fs) s2 += f.get();
+    }
+    end = std::chrono::steady_clock::now();
+    auto pool_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::size_t misses = SharedState<double>::free_list.misses - misses_before;
+
+    std::cout << rounds << " rounds x " << chunks << " chunks" << (s1 == s2 ? "" : " (MISMATCH)") << std::endl;
+    std::cout << "std::async:  " << async_us << " us" << std::endl;
+    std::cout << "pool.submit: " << pool_us << " us, "
+              << misses << " shared states allocated for " << rounds * chunks << " submits" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,397 @@
+// 編譯參數： -std=c++20 -O2
+// 1. 程式中到處都用std::this_thread::sleep_for來「等一段時間」：worker中、Singleton_Lazy_Initialization.cpp的
+//    Dosomethingexpensive、Course Notes中timeouts_and_mutexes.cpp以及hw3.cpp的輪詢(polling)迴圈，
+//    每一次sleep都會讓一整條OS執行緒什麼事都不能做。
+// 2. TimerWheel：階層式時間輪(hierarchical timing wheel)，只用一條timer執行緒管理所有的計時器。
+//    a. 4層，每層256格(slot)，第0層每格1個tick(預設1ms)，第k層每格256^k個tick，共可表示2^32個tick(約49天)。
+//    b. 每一格是一個雙向的環狀串列(intrusive doubly-linked list)，計時器依照「離現在還有多久」放進對應的層，
+//       因此加入(schedule)以及取消(cancel)都是O(1)，與目前有幾個計時器無關。
+//    c. timer執行緒每前進一個tick處理第0層的一格；第0層轉完一圈時，把上一層對應的那一格拆下來
+//       重新放到下層(cascade)。睡覺時直接睡到第0層下一個非空的格子(或下一次cascade)，不會每個tick都醒來。
+//    d. 到期的任務不在timer執行緒上執行，而是交給dispatch(例如丟到thread pool)，timer執行緒不會被任務卡住。
+//    e. 計時器節點放在自己的pool中重複使用，TimerId帶有世代編號(generation)，節點被重複使用後舊的TimerId會失效。
+// 3. ThreadPool::schedule_after(d, task) / schedule_every(period, task) / cancel(id)。
+//    週期性的任務以「上一次預定的時間 + period」計算下一次，不會因為執行的延遲而累積誤差(drift)。
+// 4. main：
+//    a. 以週期性的計時器取代hw3.cpp中reader的sleep_for輪詢迴圈，等待的期間不佔用任何執行緒。
+//    b. benchmark：100k個計時器的加入/取消成本(與std::multimap比較)，以及到期時間的誤差(lateness)。
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <map>
+#include <latch>
+#include <string>
+#include <cstdint>
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+template<typename T>
+class Queue{
+    std::deque<T> dq_;
+    std::mutex m;
+    std::atomic<bool> closed{false};
+    std::condition_variable cv;
+public:
+    void Enqueue(T val){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dq_.push_back(std::move(val));
+        }
+        cv.notify_one();
+    }
+    bool WaitandDequeue(T& value){
+        std::unique_lock<std::mutex> uk(m);
+        cv.wait(uk, [this]{return (!dq_.empty()||closed.load());});
+        if(dq_.empty()) return false;
+        value = std::move(dq_.front());
+        dq_.pop_front();
+        return true;
+    }
+    void Close(){
+        closed.store(true);
+        cv.notify_all();
+    }
+};
+
+class TimerWheel{
+    static constexpr int levels = 4;
+    static constexpr int bits = 8;
+    static constexpr std::uint64_t slots = 1 << bits;
+    static constexpr std::uint64_t mask = slots - 1;
+
+    struct Node{
+        Node* prev = this;
+        Node* next = this;
+        std::uint64_t expire = 0;       // 到期的tick
+        std::uint64_t period = 0;       // 0 = 只執行一次
+        std::uint64_t gen = 0;
+        std::function<void()> task;
+    };
+
+public:
+    struct TimerId{
+        Node* node = nullptr;
+        std::uint64_t gen = 0;
+    };
+
+    explicit TimerWheel(std::function<void(std::function<void()>)> dispatch, Clock::duration tick = 1ms)
+        : dispatch_(std::move(dispatch)), tick_(tick), start_(Clock::now()),
+          thread_([this]{ run(); }){}
+
+    ~TimerWheel(){ stop(); }
+
+    // 停止timer執行緒，還沒到期的計時器直接丟棄。
+    void stop(){
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if(stop_) return;
+            stop_ = true;
+        }
+        cv.notify_one();
+        thread_.join();
+    }
+
+    TimerId schedule_after(Clock::duration d, std::function<void()> f){ return add(d, 0, std::move(f)); }
+
+    TimerId schedule_every(Clock::duration period, std::function<void()> f){
+        return add(period, std::max<std::uint64_t>(1, to_ticks(period)), std::move(f));
+    }
+
+    // 成功取消回傳true；已經執行過(或已經取消)回傳false。
+    // 週期性的任務若已經交給dispatch，那一次仍然會執行，但之後不會再執行。
+    bool cancel(TimerId id){
+        std::lock_guard<std::mutex> lk(m);
+        if(id.node == nullptr || id.node->gen != id.gen || id.node->next == id.node) return false;
+        unlink(id.node);
+        release(id.node);
+        return true;
+    }
+
+    std::size_t pending(){
+        std::lock_guard<std::mutex> lk(m);
+        return count_;
+    }
+
+private:
+    std::function<void(std::function<void()>)> dispatch_;
+    Clock::duration tick_;
+    Clock::time_point start_;
+    std::mutex m;
+    std::condition_variable cv;
+    Node wheel_[levels][slots];         // 每一格的哨兵(sentinel)節點
+    std::deque<Node> storage_;          // 節點的位址在std::deque尾端加入時不會失效
+    std::vector<Node*> free_;
+    std::uint64_t cur_ = 0;             // 已經處理到的tick
+    std::uint64_t wake_ = UINT64_MAX;   // timer執行緒預計醒來的tick
+    std::size_t count_ = 0;
+    bool stop_ = false;
+    std::thread thread_;                // 最後一個成員：其他成員都初始化好以後才啟動
+
+    std::uint64_t to_ticks(Clock::duration d) const { return (d + tick_ - Clock::duration{1}) / tick_; }   // 無條件進位
+    std::uint64_t now_tick() const { return (Clock::now() - start_) / tick_; }
+
+    static void unlink(Node* n){
+        n->prev->next = n->next;
+        n->next->prev = n->prev;
+        n->prev = n->next = n;
+    }
+
+    static void push_back(Node* head, Node* n){
+        n->prev = head->prev;
+        n->next = head;
+        head->prev->next = n;
+        head->prev = n;
+    }
+
+    // 依照離現在還有多久決定放在哪一層，格子則由到期的tick在那一層的位元決定。
+    void place(Node* n){
+        std::uint64_t delta = n->expire > cur_ ? n->expire - cur_ : 0;
+        for(int level = 0; level < levels; level++){
+            if(delta < (std::uint64_t{1} << (bits * (level + 1))) || level == levels - 1){
+                std::uint64_t e = std::min(n->expire, cur_ + (std::uint64_t{1} << (bits * levels)) - 1);
+                push_back(&wheel_[level][(e >> (bits * level)) & mask], n);
+                return;
+            }
+        }
+    }
+
+    void release(Node* n){
+        n->task = nullptr;
+        n->gen++;
+        free_.push_back(n);
+        count_--;
+    }
+
+    TimerId add(Clock::duration d, std::uint64_t period, std::function<void()> f){
+        std::lock_guard<std::mutex> lk(m);
+        if(count_ == 0) cur_ = std::max(cur_, now_tick());   // 沒有計時器時timer執行緒不會前進，直接跳到現在
+        Node* n;
+        if(free_.empty()){
+            n = &storage_.emplace_back();
+        }else{
+            n = free_.back();
+            free_.pop_back();
+        }
+        // now_tick()無條件捨去，現在可能已經在這個tick的中間：多加一個tick，計時器才不會比d早到期。
+        n->expire = std::max(cur_ + 1, now_tick() + 1 + to_ticks(d));
+        n->period = period;
+        n->task = std::move(f);
+        place(n);
+        count_++;
+        if(n->expire < wake_) cv.notify_one();   // 比timer執行緒預計醒來的時間還早
+        return {n, n->gen};
+    }
+
+    // 前進一個tick，到期的任務放進expired。
+    void advance_locked(std::vector<std::function<void()>>& expired){
+        cur_++;
+        for(int level = 1; level < levels; level++){       // 下層轉完一圈 -> 把上層的一格拆下來重新放
+            if(((cur_ >> (bits * (level - 1))) & mask) != 0) break;
+            Node& head = wheel_[level][(cur_ >> (bits * level)) & mask];
+            while(head.next != &head){
+                Node* n = head.next;
+                unlink(n);
+                place(n);
+            }
+        }
+        Node& head = wheel_[0][cur_ & mask];
+        while(head.next != &head){
+            Node* n = head.next;
+            unlink(n);
+            if(n->period != 0){
+                expired.push_back(n->task);
+                n->expire = std::max(cur_ + 1, n->expire + n->period);
+                place(n);
+            }else{
+                expired.push_back(std::move(n->task));
+                release(n);
+            }
+        }
+    }
+
+    // 第0層中下一個非空的格子，沒有的話就是下一次cascade的時間。
+    std::uint64_t next_wakeup_locked() const {
+        std::uint64_t wrap = cur_ + (slots - (cur_ & mask));
+        for(std::uint64_t t = cur_ + 1; t < wrap; t++){
+            const Node& head = wheel_[0][t & mask];
+            if(head.next != &head) return t;
+        }
+        return wrap;
+    }
+
+    void run(){
+        std::vector<std::function<void()>> expired;
+        std::unique_lock<std::mutex> uk(m);
+        while(!stop_){
+            if(count_ == 0){
+                wake_ = UINT64_MAX;
+                cv.wait(uk, [this]{ return stop_ || count_ > 0; });
+                continue;
+            }
+            std::uint64_t now = now_tick();
+            while(cur_ < now && count_ > 0) advance_locked(expired);
+            if(count_ == 0) cur_ = std::max(cur_, now);
+            if(!expired.empty()){
+                uk.unlock();
+                for(auto& f: expired) dispatch_(std::move(f));
+                expired.clear();
+                uk.lock();
+                continue;
+            }
+            if(count_ == 0) continue;
+            wake_ = next_wakeup_locked();
+            cv.wait_until(uk, start_ + wake_ * tick_);
+        }
+    }
+};
+
+class ThreadPool{
+    Queue<std::function<void()>> Jobs;
+    std::vector<std::thread> workers;
+    TimerWheel timers{[this](std::function<void()> f){ Jobs.Enqueue(std::move(f)); }};
+public:
+    using TimerId = TimerWheel::TimerId;
+
+    explicit ThreadPool(int thread_num){
+        for(int i = 0; i < thread_num; i++){
+            workers.push_back(std::thread{[this]{
+                std::function<void()> task;
+                while(Jobs.WaitandDequeue(task)){
+                    task();
+                }
+            }});
+        }
+    }
+    ~ThreadPool(){
+        timers.stop();                  // 先停止計時器，才不會在Close以後還有任務進來
+        Jobs.Close();
+        for(auto& t: workers){
+            t.join();
+        }
+    }
+
+    template<typename F>
+    void post(F&& f){ Jobs.Enqueue(std::forward<F>(f)); }
+
+    template<typename F>
+    TimerId schedule_after(Clock::duration d, F&& f){ return timers.schedule_after(d, std::forward<F>(f)); }
+
+    template<typename F>
+    TimerId schedule_every(Clock::duration period, F&& f){ return timers.schedule_every(period, std::forward<F>(f)); }
+
+    bool cancel(TimerId id){ return timers.cancel(id); }
+
+    std::size_t pending_timers(){ return timers.pending(); }
+};
+
+long long us_since(Clock::time_point t){
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t).count();
+}
+
+int main(int argc, char* argv[]){
+    int thread_num = std::thread::hardware_concurrency();
+    std::cout << "Avaliable Threads: " << thread_num << std::endl;
+
+    // hw3.cpp的reader：不再用sleep_for(50ms)輪詢，而是每50ms由計時器檢查一次，等待的期間不佔用任何執行緒。
+    {
+        std::atomic<bool> modified{false};
+        std::string sdata{"Empty"};
+        std::mutex mut;
+        std::latch done(1);
+        ThreadPool::TimerId poll;
+        std::mutex mp;                  // 保護poll (計時器可能在schedule_every回傳之前就到期)
+        ThreadPool pool(thread_num);    // 最後宣告：~ThreadPool執行佇列中剩下的任務時，它們參考的變數都還在
+        {
+            std::lock_guard<std::mutex> lk(mp);
+            poll = pool.schedule_every(50ms, [&]{
+                if(!modified.load()) return;
+                {
+                    std::lock_guard<std::mutex> lk(mp);
+                    if(!pool.cancel(poll)) return;   // 已經有另一個worker處理過了
+                }
+                std::lock_guard<std::mutex> lk(mut);
+                std::cout << "The data is " << sdata << std::endl;
+                done.count_down();
+            });
+        }
+        pool.schedule_after(120ms, [&]{
+            std::cout << "Modifying the data" << std::endl;
+            std::lock_guard<std::mutex> lk(mut);
+            sdata = "Populated";
+            modified.store(true);
+        });
+        done.wait();
+    }
+
+    // 加入/取消的成本：時間輪 vs std::multimap (紅黑樹，O(log n))
+    int timers = argc > 1 ? std::stoi(argv[1]) : 100000;
+    {
+        std::mt19937 gen(0);
+        std::uniform_int_distribution<int> ms(1, 10 * 60 * 1000);   // 1ms ~ 10分鐘
+        std::vector<Clock::duration> delays(timers);
+        for(auto& d: delays) d = std::chrono::milliseconds(ms(gen));
+
+        TimerWheel wheel([](std::function<void()>){});
+        std::vector<TimerWheel::TimerId> ids(timers);
+        auto t0 = Clock::now();
+        for(int i = 0; i < timers; i++) ids[i] = wheel.schedule_after(delays[i], []{});
+        auto t1 = Clock::now();
+        for(int i = 0; i < timers; i++) wheel.cancel(ids[i]);
+        auto t2 = Clock::now();
+
+        std::mutex mm;
+        std::multimap<Clock::time_point, std::function<void()>> tree;
+        std::vector<decltype(tree)::iterator> its(timers);
+        auto t3 = Clock::now();
+        for(int i = 0; i < timers; i++){
+            std::lock_guard<std::mutex> lk(mm);
+            its[i] = tree.emplace(Clock::now() + delays[i], []{});
+        }
+        auto t4 = Clock::now();
+        for(int i = 0; i < timers; i++){
+            std::lock_guard<std::mutex> lk(mm);
+            tree.erase(its[i]);
+        }
+        auto t5 = Clock::now();
+
+        auto per = [&](Clock::duration d){ return std::chrono::duration<double, std::nano>(d).count() / timers; };
+        std::cout << timers << " timers, ns per op\tinsert\tcancel" << std::endl;
+        std::cout << "  timer wheel\t\t\t" << per(t1 - t0) << "\t" << per(t2 - t1) << std::endl;
+        std::cout << "  std::multimap\t\t\t" << per(t4 - t3) << "\t" << per(t5 - t4) << std::endl;
+    }
+
+    // 到期時間的誤差：timers個計時器平均分散在未來1秒內，量測實際執行的時間比預定的時間晚了多久。
+    {
+        std::vector<long long> lateness(timers);
+        std::atomic<int> fired{0};
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<int> us(0, 1000000);
+        {
+            ThreadPool pool(thread_num);
+            for(int i = 0; i < timers; i++){
+                auto d = std::chrono::microseconds(us(gen));
+                auto due = Clock::now() + d;
+                pool.schedule_after(d, [&lateness, &fired, i, due]{
+                    lateness[i] = us_since(due);
+                    fired++;
+                });
+            }
+            while(pool.pending_timers() > 0) std::this_thread::sleep_for(10ms);
+            while(fired < timers) std::this_thread::yield();
+        }
+        std::sort(lateness.begin(), lateness.end());
+        std::cout << "fired " << fired << "/" << timers << ", lateness p50: " << lateness[timers / 2] << " us"
+                  << ", p99: " << lateness[timers * 99 / 100] << " us" << ", max: " << lateness.back() << " us" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Chrome trace event記錄器 (-std=c++17以上)
+// 1. 想知道「哪一條worker在什麼時候處理了哪一段quick_sort的子區間/哪一塊map-reduce的資料」，
+//    在程式碼中放TRACE_SCOPE("名稱", "參數名", 參數值, ...)，進入scope時記錄begin(ph = "B")，
+//    離開scope時記錄end(ph = "E")。
+// 2. 只有在定義ENABLE_TRACE時才會編譯進去 (cmake -DENABLE_TRACE=ON 或是 -DENABLE_TRACE)，
+//    沒有定義時TRACE_SCOPE展開成((void)0)，參數也不會被求值，完全沒有成本。
+// 3. 每條執行緒第一次記錄時註冊一個自己的ring buffer(需要拿mutex，只有這一次)，之後的記錄都是lock-free的：
+//    只有自己會寫入，寫完一筆以後用release store更新head。滿了以後覆蓋最舊的紀錄(flight recorder)，
+//    因此保留的是最近的capacity筆事件。覆蓋以後可能留下begin已經不在的end，dump時略過這些end，
+//    trace viewer才不會顯示成壞掉的slice。
+// 4. 程式結束時(static物件解構)把所有執行緒的紀錄寫成Chrome trace JSON，
+//    檔名由環境變數TRACE_FILE決定(預設trace.json)，可以直接拖進 https://ui.perfetto.dev 或 chrome://tracing 觀看。
+//    dump時所有worker都應該已經結束(join)，否則正在覆蓋的紀錄可能被讀到一半。
+#pragma once
+
+#ifdef ENABLE_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace{
+
+using Clock = std::chrono::steady_clock;
+
+struct Record{
+    const char* name;           // 名稱以及參數名只接受string literal (static storage)，記錄時不複製字串
+    const char* k0;
+    const char* k1;
+    std::int64_t v0;
+    std::int64_t v1;
+    std::int64_t ts;            // 距離Tracer建立的時間(ns)
+    char ph;
+};
+
+class Ring{
+public:
+    static constexpr std::size_t capacity = 1 << 16;   // 必須是2的次方
+
+    explicit Ring(int tid): tid_(tid), buf_(new Record[capacity]){}   // 不初始化，用到的頁面才會真的配置
+
+    void push(const Record& r){
+        std::size_t h = head_.load(std::memory_order_relaxed);
+        buf_[h & (capacity - 1)] = r;
+        head_.store(h + 1, std::memory_order_release);
+    }
+
+    int tid() const { return tid_; }
+
+    template<typename F>
+    void for_each(F f) const {
+        std::size_t h = head_.load(std::memory_order_acquire);
+        for(std::size_t i = h > capacity ? h - capacity : 0; i < h; i++) f(buf_[i & (capacity - 1)]);
+    }
+
+private:
+    int tid_;
+    std::unique_ptr<Record[]> buf_;
+    std::atomic<std::size_t> head_{0};
+};
+
+class Tracer{
+public:
+    static Tracer& instance(){
+        static Tracer t;
+        return t;
+    }
+
+    Ring& local(){
+        thread_local Ring* ring = nullptr;
+        if(ring == nullptr){
+            std::lock_guard<std::mutex> lk(m);
+            rings_.push_back(std::make_unique<Ring>((int)rings_.size()));
+            names_.emplace_back();
+            ring = rings_.back().get();
+        }
+        return *ring;
+    }
+
+    void set_thread_name(const std::string& name){
+        int tid = local().tid();
+        std::lock_guard<std::mutex> lk(m);
+        names_[tid] = name;
+    }
+
+    std::int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+    }
+
+    void dump(const std::string& path){
+        std::lock_guard<std::mutex> lk(m);
+        std::ofstream out(path);
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto sep = [&]{
+            if(!first) out << ",\n";
+            first = false;
+        };
+        for(std::size_t tid = 0; tid < rings_.size(); tid++){
+            sep();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\""
+                << (names_[tid].empty() ? "thread " + std::to_string(tid) : names_[tid]) << "\"}}";
+        }
+        for(const auto& ring: rings_){
+            int depth = 0;                                  // 同一條執行緒的scope一定是巢狀的
+            ring->for_each([&](const Record& r){
+                if(r.ph == 'B') depth++;
+                else if(r.ph == 'E' && depth-- == 0){       // begin已經被覆蓋
+                    depth = 0;
+                    return;
+                }
+                sep();
+                out << "{\"name\":\"" << r.name << "\",\"ph\":\"" << r.ph << "\",\"pid\":1,\"tid\":" << ring->tid()
+                    << ",\"ts\":" << r.ts / 1000 << "." << (r.ts % 1000) / 100 << (r.ts % 100) / 10 << r.ts % 10;
+                if(r.k0){
+                    out << ",\"args\":{\"" << r.k0 << "\":" << r.v0;
+                    if(r.k1) out << ",\"" << r.k1 << "\":" << r.v1;
+                    out << "}";
+                }
+                out << "}";
+            });
+        }
+        out << "\n]}\n";
+    }
+
+    ~Tracer(){
+        const char* path = std::getenv("TRACE_FILE");
+        dump(path ? path : "trace.json");
+    }
+
+private:
+    Tracer(): start_(Clock::now()){}
+
+    Clock::time_point start_;
+    std::mutex m;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::vector<std::string> names_;
+};
+
+class Scope{
+public:
+    explicit Scope(const char* name, const char* k0 = nullptr, std::int64_t v0 = 0,
+                   const char* k1 = nullptr, std::int64_t v1 = 0)
+        : tracer_(Tracer::instance()), ring_(tracer_.local()), name_(name){
+        ring_.push({name, k0, k1, v0, v1, tracer_.now(), 'B'});
+    }
+    ~Scope(){
+        ring_.push({name_, nullptr, nullptr, 0, 0, tracer_.now(), 'E'});
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Tracer& tracer_;
+    Ring& ring_;
+    const char* name_;
+};
+
+}  // namespace trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+#define TRACE_THREAD_NAME(name) trace::Tracer::instance().set_thread_name(name)
+
+#else
+
+#define TRACE_SCOPE(...) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
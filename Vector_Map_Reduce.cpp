@@ -15,8 +15,10 @@
 #include <chrono>
 #include <vector>
 #include <random>
+#include "Trace_Event.hpp"   // 定義ENABLE_TRACE時記錄Chrome trace events
 
 unsigned int Max(const std::vector<unsigned int>& values){
+    TRACE_SCOPE("Max", "size", values.size());
     std::size_t numberofworkers = std::thread::hardware_concurrency();  // std::thread::hardware_concurrency();
     std::size_t sizeofrange = (values.size() + (numberofworkers-1)) / numberofworkers;
 
@@ -30,6 +32,7 @@ unsigned int Max(const std::vector<unsigned int>& values){
             workers[i] = std::jthread{[i, sizeofrange, &values, &results](){   // 此種寫法和push_back的方式一樣，都是將thread的暫時物件移動到vector內部去。
                 std::size_t start = i * sizeofrange;
                 std::size_t end = std::min(values.size(), (i+1) * sizeofrange);
+                TRACE_SCOPE("Max chunk", "from", start, "to", end);
                 results[i] = 0;
                 for(size_t j = start; j < end; j++){
                     if(values[j] > results[i]){